@@ -26,6 +26,8 @@
 #include "huc.h"
 #include "fat/fat.h"
 
+char	file_buf[SECTOR_SIZE + 1];
+
 init_screen(){
 	/* setup fonts/screen */
 	set_color_rgb(1, 7, 7, 7);
@@ -87,13 +89,13 @@ char	fptr;
 	put_string(fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_Name_os, 13, 1);
 	
 	put_string("Cluster    : 0x", 0, 2);
-	put_hex_count(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_os, 4, 15, 2);
+	put_hex_int32(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_os, 15, 2);
 	
 	put_string("Sector     : 0x", 0, 3);
-	put_hex_count(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Sector_LBA_os, 4, 15, 3);
+	put_hex_int32(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Sector_LBA_os, 15, 3);
 	
 	put_string("Size       : 0x", 0, 4);
-	put_hex_count(fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_FileSize_os, 4, 15, 4);
+	put_hex_int32(fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_FileSize_os, 15, 4);
 	
 	put_string("Attrib     : 0x", 0, 5);
 	put_hex(*fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_Attr_os, 2, 15, 5);
@@ -108,7 +110,7 @@ char	fptr;
 		Read an open file.
 	*/
 	
-	char c;
+	int	n;
 	char row, column;
 	char r;
 	put_string("[Everdrive FAT File Read]", 0, 0);
@@ -118,9 +120,9 @@ char	fptr;
 	}
 	
 	
-	fread(fptr, SECTOR_SIZE);
-	c = 0;
-	put_string(sector_buffer, 0, 1);
+	n = fread(fptr, file_buf, SECTOR_SIZE);
+	file_buf[n] = 0;
+	put_string(file_buf, 0, 1);
 	prompt_to_continue(MAX_LINES);
 }
 
@@ -26,6 +26,10 @@
 #include "huc.h"
 #include "fat/fat.h"
 
+#define BIG_BUF_SIZE	4096
+
+char	big_buf[BIG_BUF_SIZE];
+
 init_screen(){
 	set_color_rgb(1, 7, 7, 7);
 	set_font_color(1, 0);
@@ -77,46 +81,80 @@ main() {
 		/* speed test for single sector */
 		put_string("Reading 512b :", 0, 4);
 		get_timer(t1, 1);
-		error = fread(fh, SECTOR_SIZE);
+		error = fread(fh, buf, SECTOR_SIZE);
 		get_timer(t2, 0);
 		put_timer(t2, 0, 0, 5);
-		put_hex(sector_buffer[511], 2, 15, 4);
+		put_hex(buf[511], 2, 15, 4);
 		
 		/* speed test of multiple reads */
+		frewind(fh);
 		put_string("Reading 64kb :", 0, 7);
 		get_timer(t1, 1);
 		for (c=0; c<128; c++){
-			error = fread(fh, SECTOR_SIZE);
+			error = fread(fh, buf, SECTOR_SIZE);
 		}
 		get_timer(t2, 0);
 		put_timer(t2, 0, 0, 8);
 			
+		frewind(fh);
 		put_string("Reading 128kb :", 0, 10);
 		get_timer(t1, 1);
 		for (c=0; c<256; c++){
-			error = fread(fh, SECTOR_SIZE);
+			error = fread(fh, buf, SECTOR_SIZE);
 		}
 		get_timer(t2, 0);
 		put_timer(t2, 0, 0, 11);
-		put_hex(sector_buffer[511], 2, 15, 10);
+		put_hex(buf[511], 2, 15, 10);
 		
+		frewind(fh);
 		put_string("Reading 256kb :", 0, 13);
 		get_timer(t1, 1);
 		for (c=0; c<512; c++){
-			error = fread(fh, SECTOR_SIZE);
+			error = fread(fh, buf, SECTOR_SIZE);
 		}
 		get_timer(t2, 0);
 		put_timer(t2, 0, 0, 14);
-		put_hex(sector_buffer[511], 2, 15, 13);
+		put_hex(buf[511], 2, 15, 13);
 		
+		frewind(fh);
 		put_string("Reading 512kb :", 0, 16);
 		get_timer(t1, 1);
 		for (c=0; c<1024; c++){
-			error = fread(fh, SECTOR_SIZE);
+			error = fread(fh, buf, SECTOR_SIZE);
 		}
 		get_timer(t2, 0);
 		put_timer(t2, 0, 0, 17);
-		put_hex(sector_buffer[511], 2, 15, 16);
+		put_hex(buf[511], 2, 15, 16);
+		
+		/* speed test of multiple sector reads - these can use
+		a single multiple block read command for each 4kb */
+		frewind(fh);
+		put_string("Reading 64kb x4kb :", 0, 19);
+		get_timer(t1, 1);
+		for (c=0; c<16; c++){
+			error = fread(fh, big_buf, BIG_BUF_SIZE);
+		}
+		get_timer(t2, 0);
+		put_timer(t2, 0, 0, 20);
+		put_hex(big_buf[4095], 2, 20, 19);
+		
+		/* speed test of random access - seeking backwards from the end
+		of the file, a sector at a time, then reading that sector */
+		put_string("Seeking 64x512b :", 0, 22);
+		int16_to_int32(num, SECTOR_SIZE);
+		copy_int32(num2, fptr_file_size(fh));
+		get_timer(t1, 1);
+		for (c=0; c<64; c++){
+			/* num2 = file size - (c+1) x 512 - sub_int32() can't go below
+			zero, so this counts down from the end rather than building up 
+			a negative offset for SEEK_END */
+			sub_int32(num2, num2, num);
+			error = fseek(fh, num2, SEEK_SET);
+			error = fread(fh, buf, SECTOR_SIZE);
+		}
+		get_timer(t2, 0);
+		put_timer(t2, 0, 0, 23);
+		put_hex(buf[511], 2, 18, 22);
 		
 		fclose(fh);
 	} else {
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+source ../settings.ini
+
+# Build the FAT library natively against a disk image
+echo ""
+echo "========================================"
+echo " Building host disk image test program\n\n"
+
+$HOSTCC -std=gnu89 -funsigned-char -fno-builtin -no-pie -Wno-int-conversion -DFATHOST -I. -o hostimage hostimage.c
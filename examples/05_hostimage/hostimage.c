@@ -0,0 +1,200 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* Runs the Turbo Everdrive FAT library natively, against a disk image.
+*
+* Mounts the first FAT32 partition of the image, prints the filesystem
+* geometry and then opens the named file, printing its directory entry.
+* The whole file is then read with fread() in chunks of the given size,
+* and a hash of the data is printed so it can be compared with the
+* original. If the path ends with a '/', the directory is listed with
+* opendir()/readdir() instead. The number of 'card' commands each step
+* needed is shown.
+*
+* Usage: hostimage card.img [/path/to/file [chunk size [read-ahead sectors]]]
+*        hostimage card.img /path/to/dir/
+*/
+
+#include "fat/fat.h"
+
+/* <stdio.h> clashes with fat-files.h, so just declare what we use */
+int printf();
+int atoi();
+
+#define READ_BUFFER_SIZE	16384
+
+char	read_buffer[READ_BUFFER_SIZE];
+char	dir_entries[16 * FILE_DIR_sz];	/* one sector worth of entries per readdir_names() */
+char	dir_names[16 * 64];				/* and their names */
+
+show_int32(label, int32)
+char*	label;
+char*	int32;
+{
+	printf("%-12s: 0x%02x%02x%02x%02x\n", label, int32[3], int32[2], int32[1], int32[0]);
+}
+
+show_stats(label)
+char*	label;
+{
+	printf("%-12s: %ld read cmds, %ld sectors\n", label, host_disk_read_cmds, host_disk_read_sectors);
+#ifdef BLOCK_CACHE
+	show_int32("Cache hits", block_cache_hits);
+	show_int32("Cache misses", block_cache_misses);
+	zero_int32(block_cache_hits);
+	zero_int32(block_cache_misses);
+#endif
+	host_disk_reset_stats();
+}
+
+read_file(fh, chunk)
+char	fh;
+int		chunk;
+{
+	/* read a whole open file with fread() and print an FNV-1a hash of it */
+	
+	unsigned long	hash;
+	long			total;
+	int				n, i;
+
+	hash = 2166136261UL;
+	total = 0;
+	for (;;){
+		n = fread(fh, read_buffer, chunk);
+		if (n == 0) break;
+		for (i = 0; i < n; i++){
+			hash = ((hash ^ read_buffer[i]) * 16777619UL) & 0xffffffffUL;
+		}
+		total += n;
+	}
+	printf("Read        : %ld bytes in %d byte chunks, hash %08lx\n", total, chunk, hash);
+}
+
+list_dir(d_path)
+char*	d_path;
+{
+	/* list a directory with readdir_names(), a sector of entries at a time */
+
+	char	dh;
+	char*	name;
+	char*	entry;
+	int		n, i, total;
+	long	size;
+
+	dh = opendir(d_path);
+	show_stats("Open");
+	if (dh == 0){
+		printf("Open %s failed: %d\n", d_path, everdrive_error);
+		return 1;
+	}
+	total = 0;
+	for (;;){
+		n = readdir_names(dh, dir_entries, dir_names, 64, 16);
+		if (n == 0) break;
+		for (i = 0; i < n; i++){
+			entry = dir_entries + (i * FILE_DIR_sz);
+			name = dir_names + (i * 64);
+			size = ((long) entry[DIR_FileSize_os + 3] << 24) | ((long) entry[DIR_FileSize_os + 2] << 16) | ((long) entry[DIR_FileSize_os + 1] << 8) | entry[DIR_FileSize_os];
+			if (is_sub_dir(entry)){
+				printf("%-12s  <DIR>\n", name);
+			} else {
+				printf("%-12s  %ld\n", name, size);
+			}
+		}
+		total += n;
+	}
+	if (everdrive_error != ERR_NONE){
+		printf("Read failed: %d\n", everdrive_error);
+	}
+	printf("Entries     : %d\n", total);
+	show_stats("List");
+	closedir(dh);
+	return 0;
+}
+
+main(argc, argv)
+int		argc;
+char**	argv;
+{
+	char	fh;
+	int		chunk;
+
+	if (argc < 2){
+		printf("Usage: %s card.img [/path/to/file [chunk size [read-ahead sectors]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (host_disk_open(argv[1]) != ERR_NONE){
+		printf("Unable to open %s\n", argv[1]);
+		return 1;
+	}
+
+	clearFATBuffers();
+	ed_begin();
+	everdrive_error = disk_init();
+	if (everdrive_error == ERR_NONE) everdrive_error = getMBR(0);
+	if (everdrive_error == ERR_NONE) everdrive_error = getFATVol();
+	if (everdrive_error == ERR_NONE) everdrive_error = getFATFS();
+	if (everdrive_error != ERR_NONE){
+		printf("Mount failed: %d\n", everdrive_error);
+		return 1;
+	}
+	show_stats("Mount");
+
+	printf("Partition   : %d type 0x%02x\n", part_number, part_type);
+	show_int32("Part Start", part_lba_begin);
+	show_int32("FAT Start", fs_fat_lba_begin);
+	show_int32("Clus Start", fs_cluster_lba_begin);
+	show_int32("Root Clus", fs_root_dir_cluster);
+	show_int32("Sects/FAT", fs_sectors_per_fat);
+	printf("Sect Size   : %d\n", fs_sector_size);
+	printf("Sects/Clus  : %d\n", fs_sectors_per_cluster);
+
+	if ((argc > 2) && (argv[2][strlen(argv[2]) - 1] == '/')){
+		list_dir(argv[2]);
+	} else if (argc > 2){
+		fh = fopen(argv[2]);
+		show_stats("Open");
+		if (fh == 0){
+			printf("Open %s failed: %d\n", argv[2], everdrive_error);
+			return 1;
+		}
+		printf("Filename    : %.11s\n", fptr_file_name(fh));
+		show_int32("Cluster", fptr_cluster_num(fh));
+		show_int32("Sector", fptr_sector_num(fh));
+		show_int32("Size", fptr_file_size(fh));
+#ifdef FILE_EXTENTS
+		printf("Clusters    : %d in %d extents\n", fptr_get_int16(fh, FILE_Total_Clusters_os), file_extent_count[fh]);
+#endif
+
+		chunk = SECTOR_SIZE;
+		if (argc > 3) chunk = atoi(argv[3]);
+		if ((chunk < 1) || (chunk > READ_BUFFER_SIZE)) chunk = SECTOR_SIZE;
+#ifdef BLOCK_CACHE
+		if (argc > 4) printf("Read-ahead  : %d sectors\n", fsetreadahead(fh, atoi(argv[4])));
+#endif
+		read_file(fh, chunk);
+		show_stats("Read");
+		fclose(fh);
+	}
+
+	ed_end();
+	host_disk_close();
+	return 0;
+}
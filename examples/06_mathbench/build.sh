@@ -0,0 +1,19 @@
+#!/bin/bash
+
+source ../settings.ini
+
+# Time the 32bit math functions
+echo ""
+echo "========================================"
+echo " Building 32bit math benchmark (assembly)\n\n"
+
+$CC -DMATH32_ASM -s -O2 mathbench.c && $AS -s -l0 mathbench.s
+
+# ... and again with the C versions, for comparison
+echo ""
+echo "========================================"
+echo " Building 32bit math benchmark (C)\n\n"
+
+cp mathbench.c mathbench_c.c
+$CC -s -O2 mathbench_c.c && $AS -s -l0 mathbench_c.s
+rm mathbench_c.c
@@ -0,0 +1,191 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* Implements a basic test using Turbo Everdrive FAT library.
+*
+* Speed test of the 32bit math functions - each is called BENCH_CALLS times
+* and the time taken shown in 1/60th second ticks, with and without the
+* time taken by an empty loop. Build with -DMATH32_ASM (build.sh builds both
+* mathbench.pce and mathbench_c.pce) to time the assembly versions instead
+* of the C versions, and compare.
+*/
+
+#include "huc.h"
+#include "fat/fat.h"
+
+#define BENCH_CALLS		10000
+
+char	a[4], b[4], r[4];
+int		loop_ticks;
+
+init_screen(){
+	set_color_rgb(1, 7, 7, 7);
+	set_font_color(1, 0);
+	set_font_pal(0);
+	load_default_font();
+}
+
+get_ticks()
+{
+	/* Time since clock_reset() in 1/60th second ticks */
+
+	return (((clock_mm() * 60) + clock_ss()) * 60) + clock_tt();
+}
+
+put_ticks(row)
+char	row;
+{
+	/* Show the time taken by a test, and that time less the empty loop */
+
+	int	t;
+
+	t = get_ticks();
+	put_number(t, 5, 16, row);
+	put_number(t - loop_ticks, 5, 23, row);
+}
+
+main() {
+
+	int		c;
+	char	row;
+
+	init_screen();
+	#ifdef MATH32_ASM
+	put_string("[32bit Math Speed Test: asm]", 0, 0);
+	#else
+	put_string("[32bit Math Speed Test: C]", 0, 0);
+	#endif
+	put_string("10000 calls     ticks  -loop", 0, 2);
+
+	/* a - b doesn't go below zero, a + b and a++ carry between bytes */
+	a[3] = 0x12; a[2] = 0x34; a[1] = 0xFF; a[0] = 0xFF;
+	b[3] = 0x00; b[2] = 0xAB; b[1] = 0xCD; b[0] = 0xEF;
+	row = 4;
+
+	/* how long the loop itself takes */
+	put_string("empty loop", 0, row);
+	loop_ticks = 0;
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+	}
+	loop_ticks = get_ticks();
+	put_ticks(row);
+	row++;
+
+	put_string("add_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		add_int32(r, a, b);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("sub_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		sub_int32(r, a, b);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("inc_int32", 0, row);
+	copy_int32(r, a);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		inc_int32(r);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("dec_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		dec_int32(r);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("lt_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		lt_int32(a, b);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("gte_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		gte_int32(a, b);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("shift_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		shift_int32(r);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("div_pow_int32 3", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		copy_int32(r, a);
+		div_pow_int32(r, 3);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("div_pow_int32 8", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		copy_int32(r, a);
+		div_pow_int32(r, 8);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("copy_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		copy_int32(r, a);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("zero_int32", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		zero_int32(r);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("int32_is_zero", 0, row);
+	clock_reset();
+	for (c = 0; c < BENCH_CALLS; c++){
+		int32_is_zero(a);
+	}
+	put_ticks(row);
+	row++;
+
+	put_string("(div_pow includes a copy)", 0, row + 1);
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+source ../settings.ini
+
+# Build the 32bit math test natively
+echo ""
+echo "========================================"
+echo " Building host 32bit math test program\n\n"
+
+$HOSTCC -std=gnu89 -funsigned-char -fno-builtin -no-pie -Wno-int-conversion -DFATHOST -I. -o mathtest mathtest.c
@@ -0,0 +1,171 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* Tests the 32bit multiply functions of math32.h natively.
+*
+* mul_int32(), mul_int32_int16() and mul_int32_int8() are given random
+* operands of random sizes (so that products both fit and overflow) and
+* the results and overflow flags compared with the host's own 64bit
+* arithmetic. Each is also tried with the result in the same memory as
+* an operand. Every failure is printed, and the exit status is non-zero
+* if there were any.
+*
+* Usage: mathtest [number of tests [random seed]]
+*/
+
+#include "fat/fat.h"
+
+/* <stdio.h> clashes with fat-files.h, so just declare what we use */
+int printf();
+int atoi();
+
+unsigned long	rnd_state;
+long			failures;
+
+unsigned long rnd()
+{
+	/* xorshift - 32 random bits */
+
+	rnd_state ^= (rnd_state << 13) & 0xffffffffUL;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= (rnd_state << 5) & 0xffffffffUL;
+	return rnd_state;
+}
+
+unsigned long rnd_operand(max_bits)
+int		max_bits;
+{
+	/* a random number of up to max_bits bits, with the odd edge case */
+
+	unsigned long	v;
+	int				bits;
+
+	switch (rnd() % 8){
+		case 0:
+			v = 0;
+			break;
+		case 1:
+			v = 1;
+			break;
+		case 2:
+			v = 0xffffffffUL;
+			break;
+		default:
+			bits = 1 + (rnd() % 32);
+			v = rnd() >> (32 - bits);
+	}
+	if (max_bits < 32){
+		v &= (1UL << max_bits) - 1;
+	}
+	return v;
+}
+
+to_int32(int32, v)
+char*			int32;
+unsigned long	v;
+{
+	int32[3] = v >> 24;
+	int32[2] = v >> 16;
+	int32[1] = v >> 8;
+	int32[0] = v;
+}
+
+unsigned long from_int32(int32)
+char*	int32;
+{
+	return ((unsigned long) int32[3] << 24) | ((unsigned long) int32[2] << 16) | ((unsigned long) int32[1] << 8) | int32[0];
+}
+
+check(name, a, b, result, overflow)
+char*			name;
+unsigned long	a;
+unsigned long	b;
+char*			result;
+int				overflow;
+{
+	/* compare a result and overflow flag with the 64bit product of a and b */
+
+	unsigned long long	p;
+	unsigned long		want;
+	int					want_overflow;
+
+	p = (unsigned long long) a * b;
+	want = p & 0xffffffffUL;
+	want_overflow = (p > 0xffffffffULL);
+	if ((from_int32(result) != want) || (overflow != want_overflow)){
+		printf("FAIL %-15s 0x%08lx x 0x%08lx = 0x%08lx overflow %d, expected 0x%08lx overflow %d\n",
+			name, a, b, from_int32(result), overflow, want, want_overflow);
+		failures++;
+	}
+}
+
+main(argc, argv)
+int		argc;
+char**	argv;
+{
+	char			x[4], y[4], r[4];
+	unsigned long	a, b;
+	long			tests, n;
+	int				overflow;
+
+	tests = 100000;
+	rnd_state = 2463534242UL;
+	if (argc > 1) tests = atoi(argv[1]);
+	if (argc > 2) rnd_state = atoi(argv[2]) | 1;
+	failures = 0;
+
+	for (n = 0; n < tests; n++){
+		a = rnd_operand(32);
+
+		/* 32 x 32 */
+		b = rnd_operand(32);
+		to_int32(x, a);
+		to_int32(y, b);
+		overflow = mul_int32(r, x, y);
+		check("mul_int32", a, b, r, overflow);
+		overflow = mul_int32(x, x, y);
+		check("mul_int32 r=a", a, b, x, overflow);
+		to_int32(x, a);
+		overflow = mul_int32(y, x, y);
+		check("mul_int32 r=b", a, b, y, overflow);
+		to_int32(x, a);
+		overflow = mul_int32(x, x, x);
+		check("mul_int32 r=a=b", a, a, x, overflow);
+
+		/* 32 x 16 */
+		b = rnd_operand(16);
+		to_int32(r, a);
+		overflow = mul_int32_int16(r, (int) b);
+		check("mul_int32_int16", a, b, r, overflow);
+
+		/* 32 x 8 */
+		b = rnd_operand(8);
+		to_int32(x, a);
+		overflow = mul_int32_int8(r, x, b);
+		check("mul_int32_int8", a, b, r, overflow);
+		overflow = mul_int32_int8(x, x, b);
+		check("mul_int32_int8 r=a", a, b, x, overflow);
+	}
+
+	printf("%ld tests, %ld failures\n", tests, failures);
+	if (failures != 0){
+		return 1;
+	}
+	return 0;
+}
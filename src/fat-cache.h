@@ -0,0 +1,401 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* fat-cache.h
+* ======
+* A block cache of recently read sectors, shared by all open files as well
+* as directory searches and FAT lookups. Only built if BLOCK_CACHE is defined.
+*
+* Each of the BLOCK_CACHE_SLOTS slots holds one sector, tagged by its LBA
+* address. When a sector is wanted that isn't cached, the least recently used
+* slot is replaced - except for the slot holding the FAT sector used last, so
+* that streaming through a file doesn't push out the FAT sector needed to find
+* its next cluster. Hits and misses are counted in block_cache_hits and
+* block_cache_misses.
+*
+* If BLOCK_CACHE_BANK is defined, the slots are held in that RAM bank (e.g. a
+* Super System Card RAM bank) instead of the 8KB of console RAM. The bank is
+* mapped in at 0x4000 (MPR2) only while a slot is being read or copied, and
+* whatever was mapped there before is restored afterwards. The banked cache
+* has 16 slots by default, filling the bank, rather than 4 - so read-ahead
+* can go up to 14 sectors.
+*/
+
+lba_in_run(lba_x, lba, count)
+char*	lba_x;
+char*	lba;
+int		count;
+{
+	/*
+		Test if a sector address lies within a number of consecutive sectors.
+
+		Input:
+			char*	lba_x	- pointer to 32bit LBA address to test.
+			char*	lba		- pointer to 32bit LBA address of the first sector.
+			int		count	- number of sectors.
+
+		Returns:
+			1 if (lba_x - lba) is between 0 and count - 1.
+			0 if not.
+	*/
+
+	char	diff[4];
+
+	if (sub_int32(diff, lba_x, lba) != 0){
+		/* before the first sector */
+		return 0;
+	}
+	if ((diff[3] == 0) && (diff[2] == 0) && (diff[1] < 0x80)){
+		if (int32_to_int16_lsb(diff) < count){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+#ifdef BLOCK_CACHE
+
+#ifdef BLOCK_CACHE_BANKED
+char	block_cache_bank;			/* Copy of BLOCK_CACHE_BANK for the asm below. */
+char	block_cache_mpr2;			/* The bank that was mapped at 0x4000 before the block cache was mapped in. */
+
+block_cache_map()
+{
+	/* Map the RAM bank holding the block cache in at 0x4000 (MPR2) */
+
+	block_cache_bank = BLOCK_CACHE_BANK;
+#asm
+	tma		#2
+	sta		_block_cache_mpr2
+	lda		_block_cache_bank
+	tam		#2
+#endasm
+}
+
+block_cache_unmap()
+{
+	/* Restore the bank that was mapped at 0x4000 (MPR2) before block_cache_map() */
+
+#asm
+	lda		_block_cache_mpr2
+	tam		#2
+#endasm
+}
+#endif
+
+block_cache_slot(slot)
+char	slot;
+{
+	/* return the address of the memory of a slot of the block cache
+	(when banked, this is only valid while the bank is mapped in)
+
+		Input:
+			char slot	- Slot number
+
+		Output:
+			char*		- pointer to the SECTOR_SIZE bytes of the slot
+	*/
+
+	#ifdef BLOCK_CACHE_BANKED
+	return 0x4000 + (slot * SECTOR_SIZE);
+	#else
+	return block_cache + (slot * SECTOR_SIZE);
+	#endif
+}
+
+block_cache_clear()
+{
+	/*
+		Empty the block cache and zero the hit/miss counters.
+		Must be called whenever the cached sectors may no longer match the disk,
+		e.g. a new card or partition being mounted.
+	*/
+
+	char	i;
+
+	for (i = 0; i < BLOCK_CACHE_SLOTS; i++){
+		block_cache_valid[i] = 0;
+		block_cache_age[i] = i;
+	}
+	block_cache_keep = BLOCK_CACHE_NONE;
+	zero_int32(block_cache_hits);
+	zero_int32(block_cache_misses);
+	return 0;
+}
+
+block_cache_touch(slot)
+char	slot;
+{
+	/* Mark a slot as the most recently used - its age becomes 0 and
+	every slot that was used more recently than it gets one older */
+
+	char	i;
+
+	for (i = 0; i < BLOCK_CACHE_SLOTS; i++){
+		if (block_cache_age[i] < block_cache_age[slot]){
+			block_cache_age[i]++;
+		}
+	}
+	block_cache_age[slot] = 0;
+}
+
+block_cache_find(lba)
+char*	lba;
+{
+	/*
+		Find the slot of the block cache holding a sector, without reading it
+		from disk or counting a hit or miss.
+
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+
+		Returns:
+			Slot number holding the sector.
+			BLOCK_CACHE_NONE if the sector is not cached.
+	*/
+
+	char	i;
+
+	for (i = 0; i < BLOCK_CACHE_SLOTS; i++){
+		if (block_cache_valid[i]){
+			if (memcmp(block_cache_lba + (i * 4), lba, 4) == 0){
+				return i;
+			}
+		}
+	}
+	return BLOCK_CACHE_NONE;
+}
+
+block_cache_get(lba)
+char*	lba;
+{
+	/*
+		Find the slot of the block cache holding a sector, reading the sector from
+		disk into the least recently used slot if it isn't cached.
+
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+
+		Returns:
+			Slot number holding the sector.
+			BLOCK_CACHE_NONE on read failure.
+	*/
+
+	char	i;
+	char	slot;
+
+	/* Already held? */
+	slot = block_cache_find(lba);
+	if (slot != BLOCK_CACHE_NONE){
+		inc_int32(block_cache_hits);
+		block_cache_touch(slot);
+		return slot;
+	}
+	inc_int32(block_cache_misses);
+
+	/* No, use an empty slot, or else the least recently used one (other than the one to keep) */
+	slot = BLOCK_CACHE_NONE;
+	for (i = 0; i < BLOCK_CACHE_SLOTS; i++){
+		if (block_cache_valid[i] == 0){
+			slot = i;
+			break;
+		}
+		if ((i != block_cache_keep) || (BLOCK_CACHE_SLOTS == 1)){
+			if (slot == BLOCK_CACHE_NONE){
+				slot = i;
+			} else if (block_cache_age[i] > block_cache_age[slot]){
+				slot = i;
+			}
+		}
+	}
+
+	block_cache_valid[slot] = 0;
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_map();
+	#endif
+	everdrive_error = disk_read_single_sector(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), block_cache_slot(slot));
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_unmap();
+	#endif
+	if (everdrive_error != ERR_NONE){
+		return BLOCK_CACHE_NONE;
+	}
+	copy_int32(block_cache_lba + (slot * 4), lba);
+	block_cache_valid[slot] = 1;
+	block_cache_touch(slot);
+	return slot;
+}
+
+block_cache_read(lba, dest, offset, n_bytes)
+char*	lba;
+char*	dest;
+int		offset;
+int		n_bytes;
+{
+	/*
+		Copy bytes of a sector to memory, through the block cache.
+
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+			char*	dest	- memory to copy to (must not be in the 0x4000 - 0x5FFF
+								bank when the cache is banked).
+			int		offset	- byte offset within the sector to copy from.
+			int		n_bytes	- number of bytes to copy.
+
+		Returns:
+			0 on success.
+			ERR_IO_ERROR on read failure.
+	*/
+
+	char	slot;
+
+	slot = block_cache_get(lba);
+	if (slot == BLOCK_CACHE_NONE){
+		return ERR_IO_ERROR;
+	}
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_map();
+	#endif
+	memcpy(dest, block_cache_slot(slot) + offset, n_bytes);
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_unmap();
+	#endif
+	return 0;
+}
+
+block_cache_fill(lba, count)
+char*	lba;
+int		count;
+{
+	/*
+		Read a number of consecutive sectors into the block cache with a single
+		multiple block read - e.g. to read ahead of a file. They go into the 
+		neighbouring slots that were used least recently (never the one to keep).
+		If there aren't that many neighbouring slots to use, fewer sectors are read.
+
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the first sector.
+			int		count	- number of sectors (2 to BLOCK_CACHE_SLOTS - 1).
+
+		Returns:
+			0 on success.
+			ERR_IO_ERROR on read failure, or if there were no slots to use.
+	*/
+
+	char	start;
+	char	best;
+	char	best_age;
+	char	newest;
+	char	age;
+	char	i;
+	char	slot_lba[4];
+
+	/* which run of slots holds nothing used recently? - empty slots count as oldest */
+	best = BLOCK_CACHE_NONE;
+	best_age = 0;
+	while (count > 1){
+		for (start = 0; (start + count) <= BLOCK_CACHE_SLOTS; start++){
+			newest = BLOCK_CACHE_SLOTS;
+			for (i = start; i < (start + count); i++){
+				if (i == block_cache_keep){
+					newest = BLOCK_CACHE_NONE;
+					break;
+				}
+				age = BLOCK_CACHE_SLOTS;
+				if (block_cache_valid[i]){
+					age = block_cache_age[i];
+				}
+				if (age < newest){
+					newest = age;
+				}
+			}
+			if (newest != BLOCK_CACHE_NONE){
+				if ((best == BLOCK_CACHE_NONE) || (newest > best_age)){
+					best = start;
+					best_age = newest;
+				}
+			}
+		}
+		if (best != BLOCK_CACHE_NONE){
+			break;
+		}
+		/* no run of slots that long - try a shorter one */
+		count--;
+	}
+	if (best == BLOCK_CACHE_NONE){
+		return ERR_IO_ERROR;
+	}
+
+	/* drop any copies already cached elsewhere, and whatever those slots held */
+	block_cache_discard(lba, count);
+	for (i = best; i < (best + count); i++){
+		block_cache_valid[i] = 0;
+	}
+
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_map();
+	#endif
+	everdrive_error = disk_read_sectors(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), count, block_cache_slot(best));
+	#ifdef BLOCK_CACHE_BANKED
+	block_cache_unmap();
+	#endif
+	if (everdrive_error != ERR_NONE){
+		return ERR_IO_ERROR;
+	}
+
+	/* tag them, last first, so the first sector is the most recently used */
+	copy_int32(slot_lba, lba);
+	for (i = best; i < (best + count); i++){
+		copy_int32(block_cache_lba + (i * 4), slot_lba);
+		block_cache_valid[i] = 1;
+		inc_int32(slot_lba);
+		inc_int32(block_cache_misses);
+	}
+	for (i = count; i > 0; i--){
+		block_cache_touch(best + i - 1);
+	}
+	return 0;
+}
+
+block_cache_discard(lba, count)
+char*	lba;
+int		count;
+{
+	/*
+		Drop any cached copies of a number of consecutive sectors - e.g. because
+		they have just been written to the card.
+
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the first sector.
+			int		count	- number of sectors.
+	*/
+
+	char	i;
+
+	for (i = 0; i < BLOCK_CACHE_SLOTS; i++){
+		if (block_cache_valid[i]){
+			if (lba_in_run(block_cache_lba + (i * 4), lba, count)){
+				block_cache_valid[i] = 0;
+			}
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -62,6 +62,7 @@ char detect_part;
 	put_hex(addr_low, 4, 17, INFO_LINE_START + 2);
 	#endif
 	everdrive_error = disk_read_single_sector(addr_low, addr_hi, sector_buffer);
+	sector_buffer_valid = 0;
 	if (everdrive_error != ERR_NONE) {
 		/* disk read error */
 		#ifdef FATDEBUG
@@ -183,7 +184,7 @@ char detect_part;
 }
 
 isValidFAT(part_type_byte)
-char* part_type_byte;
+char part_type_byte;
 {
 	/* 
 		check a partition table entry to see if the filesystem type is FAT 
@@ -238,9 +239,8 @@ char* 	part_entry;
 		This is only needed if re-reading a partition entry, as getMBRPart reads and sets this value.
 	*/
 	
-	/* copy and flip the LBA starting sector address */
+	/* copy the LBA starting sector address - already little-endian, like all our 32bit values */
 	memcpy(part_lba_begin, part_entry + Part_LBABegin_os, Part_LBABegin_sz);
-	swap_int32(part_lba_begin);
 	return ERR_NONE;
 	
 }
@@ -0,0 +1,344 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* fat-dir-index.h
+* ======
+* An index of one (large) directory, so that finding a file in it needs one
+* sector read rather than a search through every sector of the directory.
+* Only built if DIR_INDEX is defined.
+*
+* fdirindex() reads the whole directory once, and for each of its entries
+* keeps a 16bit hash of the 8+3 name (DIR_INDEX_NONE for unused and long
+* filename entries, and the volume label), along with the LBA address of
+* every sector of the directory. find_directory_entry() then only reads the
+* sectors holding entries whose hash matches the name it is looking for -
+* usually just the one holding the file.
+*
+* If DIR_INDEX_BANK is defined, the index is held in that RAM bank (e.g. a
+* Super System Card RAM bank) and can cover DIR_INDEX_ENTRIES (3584) entries,
+* otherwise it takes 288 bytes of console RAM and covers 128. The bank is
+* mapped in at 0x4000 (MPR2) only while the index is being read or written.
+* A directory with more entries than that is indexed as far as it fits, and
+* the rest of it is still searched the slow way.
+*/
+
+#ifdef DIR_INDEX
+
+#ifdef DIR_INDEX_BANKED
+char	dir_index_bank;				/* Copy of DIR_INDEX_BANK for the asm below. */
+char	dir_index_mpr2;				/* The bank that was mapped at 0x4000 before the index was mapped in. */
+
+dir_index_map()
+{
+	/* Map the RAM bank holding the directory index in at 0x4000 (MPR2) */
+
+	dir_index_bank = DIR_INDEX_BANK;
+#asm
+	tma		#2
+	sta		_dir_index_mpr2
+	lda		_dir_index_bank
+	tam		#2
+#endasm
+}
+
+dir_index_unmap()
+{
+	/* Restore the bank that was mapped at 0x4000 (MPR2) before dir_index_map() */
+
+#asm
+	lda		_dir_index_mpr2
+	tam		#2
+#endasm
+}
+#endif
+
+dir_index_base()
+{
+	/* return the address of the directory index
+	(when banked, this is only valid while the bank is mapped in) */
+
+	#ifdef DIR_INDEX_BANKED
+	return 0x4000;
+	#else
+	return dir_index;
+	#endif
+}
+
+dir_index_clear()
+{
+	/*
+		Forget the directory index.
+		Must be called whenever the indexed directory may no longer match the disk,
+		e.g. a new card or partition being mounted.
+	*/
+
+	zero_int32(dir_index_cluster);
+	dir_index_count = 0;
+	dir_index_complete = 0;
+	return 0;
+}
+
+dir_index_holds(cluster)
+char*	cluster;
+{
+	/*
+		Test if the directory starting at a cluster is the indexed one.
+
+		Input:
+			char*	cluster		- pointer to 32bit number of the first cluster of the directory.
+
+		Returns:
+			1 if it is, 0 if not.
+	*/
+
+	if (int32_is_zero(dir_index_cluster)){
+		return 0;
+	}
+	if (memcmp(dir_index_cluster, cluster, 4) == 0){
+		return 1;
+	}
+	return 0;
+}
+
+dir_index_hash(fat_name)
+char*	fat_name;
+{
+	/*
+		Hash an 8+3 filename as held in a directory entry (e.g. "FILE    TXT"),
+		ignoring case.
+
+		Input:
+			char*	fat_name	- pointer to the DIR_Name_sz bytes of the name.
+
+		Returns:
+			The 16bit hash (never DIR_INDEX_NONE).
+	*/
+
+	int		hash;
+	char	ci;
+	char	c;
+
+	hash = 0;
+	for (ci = 0; ci < DIR_Name_sz; ci++){
+		c = fat_name[ci];
+		if ((c > 96) && (c < 123)){
+			c = c - 'a' + 'A';
+		}
+		/* hash x 33 + c */
+		hash = ((hash << 5) + hash + c) & 0xFFFF;
+	}
+	if (hash == DIR_INDEX_NONE){
+		hash = 1;
+	}
+	return hash;
+}
+
+dir_index_build()
+{
+	/*
+		Index the directory held in fwa[0], reading each of its sectors once.
+		Replaces any directory that was indexed before.
+
+		Returns:
+			0 on success.
+			ERR_IO_ERROR on read failure (there is then no index).
+	*/
+
+	char	start_cluster[4];
+	char	addr[4];
+	char	hashes[32];				/* the 16bit hashes of the entries of a sector */
+	int		hash;
+	char	s;					/* loop counter of the number of sectors per cluster */
+	char	d;					/* loop counter for the number of directory entries per sector */
+	char	done;
+	char	error;
+	char*	entry;
+	char*	base;
+	int		n;					/* number of entries indexed */
+
+	dir_index_clear();
+	copy_int32(start_cluster, fwa + FILE_Cur_Cluster_os);
+	get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
+
+	/* Mark the sector buffer as in use by the directory pointer now */
+	restore_sector_buffer(0);
+
+	n = 0;
+	done = 0;
+	while (done == 0){
+		for (s = 0; (s < FS_SECTORS_PER_CLUSTER) && (done == 0); s++){
+			if (n == DIR_INDEX_ENTRIES){
+				/* no room for the rest of the directory */
+				done = 1;
+			} else {
+				if (sector_buffer_read(addr) != 0){
+					dir_index_clear();
+					return ERR_IO_ERROR;
+				}
+				/* hash the 16 entries of the sector - up to the end of directory marker */
+				for (d = 0; d < 16; d++){
+					entry = sector_buffer + (d * FILE_DIR_sz);
+					if (is_end_of_dir(entry)){
+						dir_index_complete = 1;
+						done = 1;
+						break;
+					}
+					if (is_empty_dir_entry(entry) || is_lfn_dir_entry(entry) || is_volume_label(entry)){
+						hash = DIR_INDEX_NONE;
+					} else {
+						hash = dir_index_hash(entry + DIR_Name_os);
+					}
+					hashes[(d * 2)] = hash & 0xFF;
+					hashes[(d * 2) + 1] = (hash >> 8) & 0xFF;
+				}
+				#ifdef DIR_INDEX_BANKED
+				dir_index_map();
+				#endif
+				base = dir_index_base();
+				memcpy(base + (n * 2), hashes, d * 2);
+				memcpy(base + DIR_INDEX_LBA_os + ((n >> 4) * 4), addr, 4);
+				#ifdef DIR_INDEX_BANKED
+				dir_index_unmap();
+				#endif
+				n = n + d;
+				inc_int32(addr);
+			}
+		}
+		if (done == 0){
+			/* on to the next cluster of the directory */
+			error = get_next_cluster(fwa, 1);
+			if (error == ERR_END_OF_CHAIN){
+				dir_index_complete = 1;
+				done = 1;
+			} else if (error != 0){
+				dir_index_clear();
+				return ERR_IO_ERROR;
+			} else {
+				get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
+			}
+		}
+	}
+
+	/* Back to the start of the directory, for find_directory_entry() */
+	copy_int32(fwa + FILE_Cur_Cluster_os, start_cluster);
+	copy_int32(dir_index_cluster, start_cluster);
+	dir_index_count = n;
+	return 0;
+}
+
+dir_index_next(hash, n, lba)
+int		hash;
+int		n;
+char*	lba;
+{
+	/*
+		Find the next entry of the index with a given hash.
+
+		Input:
+			int		hash	- the 16bit hash to look for.
+			int		n		- the entry to start looking from.
+			char*	lba		- pointer to 32bit value to hold the LBA address of the sector holding the entry.
+
+		Returns:
+			The number of the entry (its sector's offset is (n & 15) x FILE_DIR_sz).
+			-1 if there are no more.
+	*/
+
+	char*	base;
+	char	hash_lo, hash_hi;
+
+	hash_lo = hash & 0xFF;
+	hash_hi = (hash >> 8) & 0xFF;
+	#ifdef DIR_INDEX_BANKED
+	dir_index_map();
+	#endif
+	base = dir_index_base();
+	while (n < dir_index_count){
+		if ((base[(n * 2)] == hash_lo) && (base[(n * 2) + 1] == hash_hi)){
+			break;
+		}
+		n++;
+	}
+	if (n < dir_index_count){
+		memcpy(lba, base + DIR_INDEX_LBA_os + ((n >> 4) * 4), 4);
+	} else {
+		n = -1;
+	}
+	#ifdef DIR_INDEX_BANKED
+	dir_index_unmap();
+	#endif
+	return n;
+}
+
+dir_index_find(fat_name, fptr, file_type)
+char*	fat_name;
+char	fptr;
+char	file_type;
+{
+	/*
+		Search the indexed directory for a named entry - as find_directory_entry().
+
+		Input:
+			char*	fat_name		- pointer to the DIR_Name_sz bytes of the name, e.g. "FILE    TXT".
+			char	fptr			- the file pointer we're conducting the search for.
+			const char file_type	- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+
+		Output:
+			0 on success.
+			ERR_FILE_NOT_FOUND if it isn't in the index.
+			ERR_IO_ERROR on read failure.
+	*/
+
+	char	lba[4];
+	int		hash;
+	char*	entry;
+	int		n;
+
+	hash = dir_index_hash(fat_name);
+
+	/* Mark the sector buffer as in use by the directory pointer now */
+	restore_sector_buffer(0);
+
+	n = dir_index_next(hash, 0, lba);
+	while (n != -1){
+		if (sector_buffer_read(lba) != 0){
+			return ERR_IO_ERROR;
+		}
+		entry = sector_buffer + ((n & 15) * FILE_DIR_sz);
+
+		/* same name, and the type we're looking for? */
+		if (memcmp(entry + DIR_Name_os, fat_name, DIR_Name_sz) == 0){
+			if (is_sub_dir(entry)){
+				if (file_type == FILE_TYPE_DIR){
+					store_directory_entry(entry, 0, 0);
+					return 0;
+				}
+			} else {
+				if (file_type == FILE_TYPE_FILE){
+					store_directory_entry(entry, fptr, 0);
+					return 0;
+				}
+			}
+		}
+		n = dir_index_next(hash, n + 1, lba);
+	}
+	return ERR_FILE_NOT_FOUND;
+}
+
+#endif
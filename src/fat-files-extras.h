@@ -33,8 +33,8 @@
 
 ==================================== */
 
-find_directory_entry(filename, fptr, file_type)
-char*	filename;
+find_directory_entry(fat_name, fptr, file_type)
+char*	fat_name;
 char	fptr;
 char	file_type;
 {
@@ -43,8 +43,17 @@ char	file_type;
 		stored at fwa[0].
 		Follows clusters if the directory entry spans more than one cluster.
 		
+		The name is given in the form it is held in a directory entry (see short_filename_pack()),
+		so that each entry can be rejected on its first byte, or else matched with a fixed
+		DIR_Name_sz byte compare.
+		
+		If a file was last found in this same directory, the search starts from its entry 
+		and wraps around to the top of the directory - so opening files in the order they 
+		are held in a directory (e.g. LEVEL01 ... LEVEL40) reads each sector of it about once
+		in all, rather than once for every file.
+		
 		Input:
-			char*	filename		- pointer to null terminated string representing the file and path.
+			char*	fat_name		- pointer to the DIR_Name_sz bytes of the name, e.g. "FILE    TXT".
 			char	fptr			- the file pointer we're conducting the search for.
 			const char file_type	- either FILE_TYPE_FILE or FILE_TYPE_DIR.
 		
@@ -53,81 +62,325 @@ char	file_type;
 			Non-zero on error or file/directory name not found.
 	*/
 	
-	char next_cluster[4];	/* temporary 32bit calculations */
+	char dir_cluster[4];	/* first cluster of the directory */
+	char r;					/* result of a search */
+	
+	#ifdef DIR_INDEX
+	/* If this is the indexed directory, only the sectors of the entries with the right hash need reading */
+	if (dir_index_holds(fwa + FILE_Cur_Cluster_os)){
+		r = dir_index_find(fat_name, fptr, file_type);
+		if ((r == 0) || (r == ERR_IO_ERROR)){
+			return r;
+		}
+		if ((r == ERR_FILE_NOT_FOUND) && (dir_index_complete)){
+			/* every entry of the directory is in the index, so it isn't there */
+			return ERR_END_OF_DIRECTORY;
+		}
+		/* otherwise it may be beyond the end of the index - search the directory as normal */
+	}
+	#endif
+	
+	copy_int32(dir_cluster, fwa + FILE_Cur_Cluster_os);
+	if ((int32_is_zero(dir_resume_dir) == 0) && (memcmp(dir_resume_dir, dir_cluster, 4) == 0)){
+		/* Start from the entry last found in this directory ... */
+		copy_int32(fwa + FILE_Cur_Cluster_os, dir_resume_cluster);
+		r = search_directory(fat_name, fptr, file_type, dir_resume_sector, dir_resume_entry, 0);
+		if ((r != ERR_END_OF_DIRECTORY) && (r != ERR_END_OF_CHAIN)){
+			return r;
+		}
+		/* ... then go back to the top, as far as that entry */
+		copy_int32(fwa + FILE_Cur_Cluster_os, dir_cluster);
+		r = search_directory(fat_name, fptr, file_type, 0, 0, 1);
+	} else {
+		r = search_directory(fat_name, fptr, file_type, 0, 0, 0);
+	}
+	if ((r == 0) && (file_type == FILE_TYPE_FILE)){
+		/* only files move the starting point - not the directories of a path on the way to a file */
+		copy_int32(dir_resume_dir, dir_cluster);
+	}
+	return r;
+}
+
+search_directory(fat_name, fptr, file_type, s_start, d_start, stop)
+char*	fat_name;
+char	fptr;
+char	file_type;
+char	s_start;
+char	d_start;
+char	stop;
+{
+	/*
+		Searches a directory for a named entry, for find_directory_entry(), from a given 
+		entry of the cluster stored at fwa[0] onwards.
+		
+		Input:
+			char*	fat_name		- pointer to the DIR_Name_sz bytes of the name, e.g. "FILE    TXT".
+			char	fptr			- the file pointer we're conducting the search for.
+			const char file_type	- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+			char	s_start			- the sector of the cluster to start from.
+			char	d_start			- the entry of that sector to start from.
+			char	stop			- 1 to stop at the entry last found (dir_resume_cluster, 
+										dir_resume_sector, dir_resume_entry), 0 to search to the end.
+		
+		Output:
+			0 on success - the entry of a file found is noted in dir_resume_cluster, dir_resume_sector
+			and dir_resume_entry.
+			Non-zero on error or file/directory name not found.
+	*/
+	
 	char s;					/* loop counter of the number of sectors per cluster */
 	char d;					/* loop counter for the number of directory entries per sector */
 	char addr[4]; 			/* temporary address buffer */
+	char* entry;			/* the directory entry being compared */
 	
 	get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
+	for (s = 0; s < s_start; s++){
+		inc_int32(addr);
+	}
 
 	/* Mark the sector buffer as in use by this file pointer now */
 	restore_sector_buffer(0);
 	
-	/* Set the next cluster to initially be the first one we know */
-	memcpy(next_cluster, fwa + FILE_Cur_Cluster_os, 4);
-		
 	/* While there are some clusters left in this chain ... */
-	while (int32_is_zero(next_cluster) != 1){
+	for (;;){
 		/* Until we've exhausted all sectors from this cluster ... */
-		for (s = 0; s < fs_sectors_per_cluster; s++){
+		for (s = s_start; s < FS_SECTORS_PER_CLUSTER; s++){
 			/* Read 512 bytes of the sector into the buffer */
-			everdrive_error = disk_read_single_sector(int32_to_int16_lsb(addr), int32_to_int16_msb(addr), sector_buffer);
-			if (everdrive_error != ERR_NONE){
+			if (sector_buffer_read(addr) != 0){
 				return ERR_IO_ERROR;
 			}
 			/* loop through each 32byte record of this sector (16 records per sector) to see if we find a directory entry that matches */
-			for (d = 0; d < 16; d++){
+			for (d = d_start; d < 16; d++){
+				entry = sector_buffer + (d * FILE_DIR_sz);
+				
+				/* Back to where the search started? */
+				if ((stop == 1) && (d == dir_resume_entry) && (s == dir_resume_sector)){
+					if (memcmp(fwa + FILE_Cur_Cluster_os, dir_resume_cluster, 4) == 0){
+						return ERR_END_OF_DIRECTORY;
+					}
+				}
+				
 				/* Check the type of the directory entry */ 
-				if (is_end_of_dir(sector_buffer + (d * FILE_DIR_sz))){
+				if (is_end_of_dir(entry)){
 					/* end of directory */
 					return ERR_END_OF_DIRECTORY;
 					
-				} else if (is_empty_dir_entry(sector_buffer + (d * FILE_DIR_sz))){
-					/* unused directory entry */
+				} else if (entry[DIR_Name_os] != fat_name[0]){
+					/* a different name - or an unused directory entry */
 					
-				} else if (is_lfn_dir_entry(sector_buffer + (d * FILE_DIR_sz))){
-					/* longfilename directory entry */
+				} else if (is_lfn_dir_entry(entry) || is_volume_label(entry)){
+					/* longfilename directory entry or volume label */
 					
-				} else {
-					/* normal directory entry - could be file or subdir */
+				} else if (memcmp(entry + DIR_Name_os, fat_name, DIR_Name_sz) == 0){
+					/* the name we're looking for - could be file or subdir */
 					
 					/* is it a sub dir - check bit 3 of the attrib byte */
-					if (is_sub_dir(sector_buffer + (d * FILE_DIR_sz))){
-						/* sub dir */
-						
+					if (is_sub_dir(entry)){
 						/* are we actually looking for a subdir at this point */
 						if (file_type == FILE_TYPE_DIR){
-							if (short_filename_match(sector_buffer + (d * FILE_DIR_sz) + DIR_Name_os, filename, 12 + d) == 1){
-								/* we found the sub directory!
-								store the directory entry, so the next search will start
-								from that folder/cluster instead of root */
-								store_directory_entry(sector_buffer + (d * FILE_DIR_sz), 0, 0);
-								return 0;
-							}
+							/* we found the sub directory!
+							store the directory entry, so the next search will start
+							from that folder/cluster instead of root */
+							store_directory_entry(entry, 0, 0);
+							return 0;
 						}
 					} else {
-						/* file */
-						
 						/* are we actually looking for a file at this point */
 						if (file_type == FILE_TYPE_FILE){
-							if (short_filename_match(sector_buffer + (d * FILE_DIR_sz) + DIR_Name_os, filename, 12 + d) == 1){
-								/* we found the file!
-								store its directory entry under the correct file pointer number */
-								store_directory_entry(sector_buffer + (d * FILE_DIR_sz), fptr, 0);
-								return 0;
-							}
+							/* we found the file!
+							store its directory entry under the correct file pointer number */
+							copy_int32(dir_resume_cluster, fwa + FILE_Cur_Cluster_os);
+							dir_resume_sector = s;
+							dir_resume_entry = d;
+							store_directory_entry(entry, fptr, 0);
+							return 0;
 						}
 					}
 				}
 			}
+			d_start = 0;
+			inc_int32(addr);
 		}
+		s_start = 0;
 		/* lookup and set next cluster */
-		if (get_next_cluster(fwa + FILE_Cur_Cluster_os, 1) != 0){
+		if (get_next_cluster(fwa, 1) != 0){
 			/* If there isn't a next cluster, return file not found and end of chain */
 			return ERR_END_OF_CHAIN;
 		}
+		get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
 	}
+}
+
+find_path_entry(name, fptr, file_type)
+char*	name;
+char	fptr;
+char	file_type;
+{
+	/*
+		Searches the directory stored at fwa[0] for one of the names in a path, 
+		as find_directory_entry().
+		
+		A valid 8+3 name is looked for as it is held in a directory entry. When 
+		LONG_FILENAMES is defined, any other name is looked for as a long filename.
+		
+		If MISS_CACHE is defined, an 8+3 name recently found not to be in the directory
+		isn't looked for again.
+		
+		Input:
+			char*	name			- pointer to the name, ended by a directory seperator or null.
+			char	fptr			- the file pointer we're conducting the search for.
+			const char file_type	- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+		
+		Output:
+			0 on success.
+			Non-zero on error or file/directory name not found.
+	*/
+	
+	char	fat_name[DIR_Name_sz];
+	#ifdef LONG_FILENAMES
+	int		len;
+	#endif
+	#ifdef MISS_CACHE
+	char	dir_cluster[4];
+	char	error;
+	#endif
+	
+	if (short_filename_pack(name, fat_name) == 0){
+		#ifdef MISS_CACHE
+		/* Already known not to be there? */
+		if (miss_cache_find(fwa + FILE_Cur_Cluster_os, fat_name, file_type)){
+			return ERR_END_OF_DIRECTORY;
+		}
+		/* the search moves fwa[0] along the cluster chain of the directory, so note where it starts */
+		copy_int32(dir_cluster, fwa + FILE_Cur_Cluster_os);
+		error = find_directory_entry(fat_name, fptr, file_type);
+		if ((error == ERR_END_OF_DIRECTORY) || (error == ERR_END_OF_CHAIN)){
+			miss_cache_add(dir_cluster, fat_name, file_type);
+		}
+		return error;
+		#else
+		return find_directory_entry(fat_name, fptr, file_type);
+		#endif
+	}
+	#ifdef LONG_FILENAMES
+	len = 0;
+	while ((name[len] != 0x00) && (name[len] != 0x2F) && (name[len] != 0x5C)){
+		len++;
+	}
+	return find_lfn_directory_entry(name, len, fptr, file_type);
+	#else
 	return ERR_FILE_NOT_FOUND;
+	#endif
+}
+
+load_start_directory(relative)
+char	relative;
+{
+	/*
+		Load the directory a path starts from into fwa[0] - the root directory,
+		or for a relative path the working directory set by chdir().
+		
+		Input:
+			char	relative	- 1 if the path is relative (has no leading slash), 0 if not.
+	*/
+	
+	store_directory_entry(0, 0, 1);
+	if ((relative == 1) && (int32_is_zero(cwd_cluster) == 0)){
+		copy_int32(fwa + FILE_Cur_Cluster_os, cwd_cluster);
+	}
+}
+
+load_directory(d_path)
+char*	d_path;
+{
+	/*
+		Load the directory entry of a directory into fwa[0], so that it is the one
+		searched by find_directory_entry(). Each directory in the path is searched
+		for in turn, starting from the root - or from the working directory set by 
+		chdir() if the path has no leading slash.
+		
+		Input:
+			char*	d_path	- pointer to a null terminated path to a directory, e.g.
+							"/games/japan" or "\games\japan\" - "/" is the root directory,
+							"" the working directory.
+							
+		Output:
+			0 on success.
+			ERR_DIR_NOT_FOUND or ERR_FILENAME_TOO_LONG on error.
+	*/
+	
+	int		s_start, s_end;
+	
+	/* Strip any leading whitespace from the path */
+	while (*d_path == ' '){
+		d_path++;
+	}
+	
+	/* Start from the root directory if there is a leading directory seperator */
+	if ((*d_path == '/') || (*d_path == '\\')){
+		d_path++;
+		load_start_directory(0);
+	} else {
+		load_start_directory(1);
+	}
+	
+	s_start = 0;
+	s_end = 0;
+	for (;;){
+		if ((d_path[s_end] == 0x2F) || (d_path[s_end] == 0x5C) || (d_path[s_end] == 0x00)){
+			/* the end of a directory name - unless it is empty, e.g. a trailing slash */
+			if (s_end > s_start){
+				if (find_path_entry(d_path + s_start, 0, FILE_TYPE_DIR) != 0){
+					return ERR_DIR_NOT_FOUND;
+				}
+			}
+			if (d_path[s_end] == 0x00){
+				return 0;
+			}
+			s_start = s_end + 1;
+		} else if ((s_end - s_start) >= MAX_NAME_SIZE){
+			return ERR_FILENAME_TOO_LONG;
+		}
+		s_end++;
+	}
+}
+
+dir_next_sector(dir_work)
+char*	dir_work;
+{
+	/*
+		Move an open directory on to its next sector, following its cluster chain
+		when the end of a cluster is reached.
+		
+		Input:
+			char*	dir_work	- pointer to the work area of the directory in dwa.
+			
+		Output:
+			0 on success.
+			ERR_END_OF_CHAIN if there are no more sectors.
+			ERR_IO_ERROR on read failure.
+	*/
+	
+	char	sector_count;
+	char	error;
+	
+	sector_count = dir_work[FILE_Cur_Sector_Count_os] + 1;
+	if (sector_count < FS_SECTORS_PER_CLUSTER){
+		/* the next sector of the same cluster */
+		dir_work[FILE_Cur_Sector_Count_os] = sector_count;
+		inc_int32(dir_work + FILE_Cur_Sector_LBA_os);
+	} else {
+		/* the first sector of the next cluster */
+		error = get_next_cluster(dir_work, 1);
+		if (error != 0){
+			return error;
+		}
+		dir_work[FILE_Cur_Sector_Count_os] = 0;
+		get_sector_for_cluster(dir_work + FILE_Cur_Sector_LBA_os, dir_work + FILE_Cur_Cluster_os);
+	}
+	dir_work[FILE_Cur_PosInBuffer_os] = 0;
+	dir_work[FILE_Cur_PosInBuffer_os + 1] = 0;
+	return 0;
 }
 
 get_next_sector(dir_entry, set)
@@ -173,8 +426,6 @@ char	fptr;
 			Non-zero on error.
 	*/
 
-	int	addr_lo, addr_hi;
-	
 	/* Don't need to do anything, already own the buffer */
 	if (sector_buffer_current_fptr == fptr) return 0;
 	
@@ -184,26 +435,191 @@ char	fptr;
 	TO DO !!!
 	if ((fwa[((fptr * FILE_WORK_SIZE) + FILE_Cur_PosInBuffer_os)] != SECTOR_SIZE) || (fwa[((fptr * FILE_WORK_SIZE) + FILE_Cur_PosInBuffer_os + 1)] != 0)){
 	*/
-	if (*fptr_sector_pos(fptr) < (fs_sector_size - 1)){
-		addr_lo = int32_to_int16_lsb(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Sector_LBA_os);
-		addr_hi = int32_to_int16_msb(fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Sector_LBA_os);
-		everdrive_error = disk_read_single_sector(addr_lo, addr_hi, sector_buffer);
-		if (everdrive_error != ERR_NONE){
-			return ERR_IO_ERROR;
+	if ((fptr_sector_pos(fptr) > 0) && (fptr_sector_pos(fptr) < SECTOR_SIZE)){
+		return sector_buffer_read(fptr_sector_num(fptr));
+	}
+	
+	return 0;
+	
+}
+
+sector_buffer_read(lba)
+char*	lba;
+{
+	/*
+		Read a sector into the sector buffer - unless the buffer already
+		holds that sector, in which case the card isn't touched at all.
+		
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+			
+		Returns:
+			0 on success.
+			ERR_IO_ERROR on read failure.
+	*/
+	
+	if (sector_buffer_holds(lba)){
+		return 0;
+	}
+	
+	sector_buffer_valid = 0;
+	#ifdef BLOCK_CACHE
+	if (block_cache_read(lba, sector_buffer, 0, SECTOR_SIZE) != 0){
+		return ERR_IO_ERROR;
+	}
+	#else
+	everdrive_error = disk_read_single_sector(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), sector_buffer);
+	if (everdrive_error != ERR_NONE){
+		return ERR_IO_ERROR;
+	}
+	#endif
+	copy_int32(sector_buffer_lba, lba);
+	sector_buffer_valid = 1;
+	return 0;
+}
+
+sector_buffer_holds(lba)
+char*	lba;
+{
+	/*
+		Test if the sector buffer holds an unchanged copy of a sector.
+		
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+			
+		Returns:
+			1 if it does, 0 if not.
+	*/
+	
+	if (sector_buffer_valid){
+		if (memcmp(sector_buffer_lba, lba, 4) == 0){
+			return 1;
 		}
 	}
+	return 0;
+}
+
+sector_is_cached(lba)
+char*	lba;
+{
+	/*
+		Test if a sector can be had without reading the card - i.e. it is in 
+		the sector buffer, or the block cache.
+		
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the sector.
+			
+		Returns:
+			1 if it is, 0 if not.
+	*/
 	
+	if (sector_buffer_holds(lba)){
+		return 1;
+	}
+	#ifdef BLOCK_CACHE
+	if (block_cache_find(lba) != BLOCK_CACHE_NONE){
+		return 1;
+	}
+	#endif
 	return 0;
+}
+
+sector_buffer_discard(lba, count)
+char*	lba;
+int		count;
+{
+	/*
+		Forget the contents of the sector buffer (and block cache) if it holds one of 
+		a number of consecutive sectors - e.g. because they have just been written to 
+		the card from somewhere else.
+		
+		Input:
+			char*	lba		- pointer to 32bit LBA address of the first sector.
+			int		count	- number of sectors.
+	*/
 	
+	if (sector_buffer_valid){
+		if (lba_in_run(sector_buffer_lba, lba, count)){
+			sector_buffer_valid = 0;
+		}
+	}
+	#ifdef BLOCK_CACHE
+	block_cache_discard(lba, count);
+	#endif
+	return 0;
 }
 
-get_next_cluster(dir_entry, set)
-char*	dir_entry;
-char	set;
+#ifndef BLOCK_CACHE
+fat_cache_clear()
 {
+	/*
+		Empty the FAT sector cache.
+		Must be called whenever the cached sectors may no longer match the disk,
+		e.g. a new card or partition being mounted.
+	*/
 	
+	char	i;
+	
+	for (i = 0; i < FAT_CACHE_ENTRIES; i++){
+		fat_cache_valid[i] = 0;
+	}
+	fat_cache_next = 0;
+	return 0;
+}
+
+fat_cache_get(fat_sector_lba)
+char*	fat_sector_lba;
+{
 	/*
-		Given a directory entry, read the FAT to see what its next cluster in the chain is.
+		Return the FAT sector at a given LBA address from the FAT cache.
+		On a miss the oldest entry is replaced by reading the sector from disk.
+		
+		Input:
+			char*	fat_sector_lba	- pointer to 32bit LBA address of a sector of the FAT.
+			
+		Returns:
+			Pointer to the SECTOR_SIZE bytes of the cached sector.
+			0 on read failure.
+	*/
+	
+	char	i;
+	char*	entry;
+	
+	/* Already held? */
+	for (i = 0; i < FAT_CACHE_ENTRIES; i++){
+		if (fat_cache_valid[i]){
+			if (memcmp(fat_cache_lba + (i * 4), fat_sector_lba, 4) == 0){
+				return fat_cache + (i * SECTOR_SIZE);
+			}
+		}
+	}
+	
+	/* No, replace entries in turn */
+	i = fat_cache_next;
+	fat_cache_next++;
+	if (fat_cache_next == FAT_CACHE_ENTRIES){
+		fat_cache_next = 0;
+	}
+	
+	entry = fat_cache + (i * SECTOR_SIZE);
+	fat_cache_valid[i] = 0;
+	everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fat_sector_lba), int32_to_int16_msb(fat_sector_lba), entry);
+	if (everdrive_error != ERR_NONE){
+		return 0;
+	}
+	copy_int32(fat_cache_lba + (i * 4), fat_sector_lba);
+	fat_cache_valid[i] = 1;
+	return entry;
+}
+#endif
+
+get_fat_entry(cluster_number, next_cluster)
+char*	cluster_number;
+char*	next_cluster;
+{
+	
+	/*
+		Read the FAT entry of a cluster, i.e. the number of the next cluster in its chain.
 		How to find a FAT entry for a cluster 
 		A FAT entry is 32bits
 		128 entries per sector (assuming sector = 512bytes)
@@ -214,77 +630,94 @@ char	set;
 			255 / 128 = 1..... 
 			sector = fs_fat_lba_begin + 1
 			read sector 
+			entry = 255 - (1 x 128) = 127
 			
 		Input:
-			char*	dir_entry	- pointer to directory entry structure.
-			char	set			- if true, updates directory entry current cluster and current sector fields.
+			char*	cluster_number	- pointer to 32bit cluster number.
+			char*	next_cluster	- pointer to 32bit value to hold the next cluster number.
 			
 		Returns:
 			0 on success and detection of the available next cluster.
-			Non-zero on cluster not found or no next cluster.
+			ERR_END_OF_CHAIN if the cluster is the last in its chain.
+			ERR_IO_ERROR on read failure.
 	*/
 	
 	char	fat_sector_lba[4];
 	char	fat_sector_offset[4];
-	char	skip_sectors[4];
-	char	end_of_file[4];
-	char	skip_records[4];
-	char	next_cluster[4];
-	
-	end_of_file[0] = 0xFF;
-	end_of_file[1] = 0xFF;
-	end_of_file[2] = 0xFF;
-	end_of_file[3] = 0xFF;
-	
-	restore_sector_buffer(0);
-	
-	zero_int32(fat_sector_lba);
-	zero_int32(fat_sector_offset);
-	zero_int32(skip_sectors);
-	zero_int32(skip_records);
+	int		entry_os;
+	#ifndef BLOCK_CACHE
+	char*	fat_sector;			/* the FAT sector, as held in the FAT cache */
+	#endif
 	
 	/* Take a copy of the current cluster number - eg 255 */	
-	copy_int32(fat_sector_offset, dir_entry + FILE_Cur_Cluster_os);
+	copy_int32(fat_sector_offset, cluster_number);
 	
 	/* Divide by 128 to get number of sectors in the FAT before the one that holds our desired cluster chain - eg 1 */
-	div_pow_int32(fat_sector_offset, 7);
-	
-	/* Multiply the number of sectors found by the number of fat entries in one sector - eg 1 x 128 */
-	mul_int32_int8(skip_sectors, fat_sector_offset, CLUSTER_FAT_ENTRIES_SECT);
+	div_pow_int32(fat_sector_offset, CLUSTER_FAT_ENTRIES_SHIFT);
 	
-	/* Subtract that number from the current cluster number - eg 255 - 128 = 127 
-	This is how many 32bit records we need to skip in the sector buffer until we get to the one we want */
-	
-	/* THIS IS NOT IMPLEMENTED!!!
-	TO DO !!!
-	*/
-	sub_int32(skip_records, fat_sector_offset, skip_sectors);
+	/* The remainder is the number of 32bit records we need to skip in the sector buffer until we get to the one we want - eg 127 */
+	entry_os = (cluster_number[0] & (CLUSTER_FAT_ENTRIES_SECT - 1)) * CLUSTER_FAT_ENTRY_SIZE;
 	
 	/* Add the offset onto the start sector for the fat to let the hardware know what sector of the disk to read */
 	add_int32(fat_sector_lba, fs_fat_lba_begin, fat_sector_offset);
 	
-	everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fat_sector_lba), int32_to_int16_msb(fat_sector_lba), sector_buffer);
-	if (everdrive_error != ERR_NONE){
+	/* Find the FAT sector in the FAT (or block) cache, reading it from disk only if it isn't already held */
+	#ifdef BLOCK_CACHE
+	if (block_cache_read(fat_sector_lba, next_cluster, entry_os, CLUSTER_FAT_ENTRY_SIZE) != 0){
 		return ERR_IO_ERROR;
-	} else {
-		memcpy(next_cluster, sector_buffer + (skip_records * CLUSTER_FAT_ENTRY_SIZE), CLUSTER_FAT_ENTRY_SIZE);
-		/* test if valid next cluster */
-		if (gte_int32(next_cluster, end_of_file)){
-			/* invalid - current cluster is marked as last */
-			return 1;	
-		}
-		/* if valid and if set then update cluster number */
-		if (set == 1){
-			/* update dir entry 
-			memcpy(dir_entry + FILE_Cur_Cluster_os, sector_buffer + (mul_int32(skip_records * CLUSTER_FAT_ENTRY_SIZE), FILE_Cur_Cluster_sz);
-			*/
-			/* correct endian-ness */
-			swap_int32(dir_entry + FILE_Cur_Cluster_os);
-			return 0;
-		}
-		/* if valid return 0 == next cluster found */
-		return 0;
 	}
+	/* keep it cached while file data streams through the other slots */
+	block_cache_keep = block_cache_find(fat_sector_lba);
+	#else
+	fat_sector = fat_cache_get(fat_sector_lba);
+	if (fat_sector == 0){
+		return ERR_IO_ERROR;
+	}
+	memcpy(next_cluster, fat_sector + entry_os, CLUSTER_FAT_ENTRY_SIZE);
+	#endif
+	/* drop the 4 reserved high bits of a FAT32 entry */
+	next_cluster[3] = next_cluster[3] & 0x0F;
+	
+	/* test if valid next cluster - 0x0FFFFFF8+ is end of chain, 0x0FFFFFF7 a bad cluster and 0 a free one */
+	if ((next_cluster[3] == 0x0F) && (next_cluster[2] == 0xFF) && (next_cluster[1] == 0xFF) && (next_cluster[0] >= 0xF7)){
+		return ERR_END_OF_CHAIN;	
+	}
+	if (int32_is_zero(next_cluster)){
+		return ERR_END_OF_CHAIN;
+	}
+	return 0;
+}
+
+get_next_cluster(dir_entry, set)
+char*	dir_entry;
+char	set;
+{
+	
+	/*
+		Given a directory entry, read the FAT to see what its next cluster in the chain is.
+			
+		Input:
+			char*	dir_entry	- pointer to directory entry structure.
+			char	set			- if true, updates directory entry current cluster field.
+			
+		Returns:
+			0 on success and detection of the available next cluster.
+			Non-zero on cluster not found or no next cluster.
+	*/
+	
+	char	next_cluster[4];
+	char	error;
+	
+	error = get_fat_entry(dir_entry + FILE_Cur_Cluster_os, next_cluster);
+	if (error != 0){
+		return error;
+	}
+	/* if valid and if set then update cluster number */
+	if (set == 1){
+		copy_int32(dir_entry + FILE_Cur_Cluster_os, next_cluster);
+	}
+	/* if valid return 0 == next cluster found */
+	return 0;
 }
 
 is_empty_dir_entry(dir_entry)
@@ -308,9 +741,20 @@ char*	dir_entry;
 is_lfn_dir_entry(dir_entry)
 char*	dir_entry;
 {
-	/* Checks for a longfilename signature at a dir entry - returns true if all 4 least significant bits must be set */
+	/* Checks for a longfilename signature at a dir entry - returns true if the read-only, hidden, 
+	system and volume label bits are all set, and the directory and archive bits are not */
+
+	if ((dir_entry[DIR_Attr_os] & 0x3F) == 0x0F) return 1;
+	return 0;	
+}
+
+is_volume_label(dir_entry)
+char*	dir_entry;
+{
+	/* Checks for the volume label of a partition - held in the root directory like a file, 
+	but with bit 3 of the attrib byte set (longfilename entries must be checked for first) */
 
-	if (dir_entry[DIR_Attr_os] & 0x0F) return 1;
+	if (dir_entry[DIR_Attr_os] & 0x08) return 1;
 	return 0;	
 }
 
@@ -336,17 +780,16 @@ char*	cluster_number;
 		lba_addr = cluster_begin_lba + ((cluster_number - 2) * sectors_per_cluster);		
 	*/
 	
-	char offset_num_clusters[4], offset_num_sectors[4];
+	char offset_num_sectors[4];
 	
 	if (memcmp(cluster_number, fs_root_dir_cluster, 4) == 0){
 		memcpy(address, fs_cluster_lba_begin, 4);
 	} else {
-		zero_int32(offset_num_sectors);
-		copy_int32(offset_num_clusters, cluster_number);
-		dec_int32(offset_num_clusters);
-		dec_int32(offset_num_clusters);
-		mul_int32_int8(offset_num_sectors, offset_num_clusters, fs_sectors_per_cluster);
-		put_hex_count(offset_num_clusters, 4, 0, MAX_LINES);
+		/* sectors_per_cluster is a power of 2, so multiply by shifting */
+		copy_int32(offset_num_sectors, cluster_number);
+		dec_int32(offset_num_sectors);
+		dec_int32(offset_num_sectors);
+		mul_pow_int32(offset_num_sectors, fs_cluster_shift);
 		add_int32(address, fs_cluster_lba_begin, offset_num_sectors);
 	}
 }
@@ -386,13 +829,8 @@ char	use_root;
 		/* No, store new (sub) directory or file entry */
 		memcpy(fwa + (fptr * FILE_WORK_SIZE), base_addr, FILE_DIR_sz); 
 		
-		/* Byte swap from little to big-endian: filesize and cluster number */
-		swap_int32(fwa + fptr_offset + FILE_DIR_os + DIR_FileSize_os);
-		swap_int16(fwa + fptr_offset + FILE_DIR_os + DIR_FstClusHI_os);
-		swap_int16(fwa + fptr_offset + FILE_DIR_os + DIR_FstClusLO_os);
-		
-		/* Set total number of clusters to be 0 */
-		/* TODO go off and count cluster chain */
+		/* Set total number of clusters to be 0 - i.e. not known,
+		it is counted by fptr_build_extents() if FILE_EXTENTS is defined */
 		fwa[(fptr_offset + FILE_Total_Clusters_os)] = 0;
 		fwa[(fptr_offset + FILE_Total_Clusters_os + 1)] = 0;
 		
@@ -404,12 +842,13 @@ char	use_root;
 		zero_int32(fwa + fptr_offset + FILE_Cur_PosInFile_os);
 		
 		/* Set current byte position in sector buffer to be 0 */
-		zero_int32(fwa + fptr_offset + FILE_Cur_PosInBuffer_os);
+		fwa[(fptr_offset + FILE_Cur_PosInBuffer_os)] = 0;
+		fwa[(fptr_offset + FILE_Cur_PosInBuffer_os + 1)] = 0;
 		
 		/* Set current cluster number to be the starting cluster 
-		found in the directory entry fields */
-		memcpy(fwa + fptr_offset + FILE_Cur_Cluster_os, fwa + fptr_offset + FILE_DIR_os + DIR_FstClusHI_os, 2);
-		memcpy(fwa + fptr_offset + FILE_Cur_Cluster_os + 2, fwa + fptr_offset + FILE_DIR_os + DIR_FstClusLO_os, 2);
+		found in the directory entry fields (low 16bits first) */
+		memcpy(fwa + fptr_offset + FILE_Cur_Cluster_os, fwa + fptr_offset + FILE_DIR_os + DIR_FstClusLO_os, 2);
+		memcpy(fwa + fptr_offset + FILE_Cur_Cluster_os + 2, fwa + fptr_offset + FILE_DIR_os + DIR_FstClusHI_os, 2);
 	
 		/* Set current sector number to be the first one in the starting cluster */
 		get_sector_for_cluster(fwa + fptr_offset + FILE_Cur_Sector_LBA_os, fwa + fptr_offset + FILE_Cur_Cluster_os);
@@ -420,6 +859,332 @@ char	use_root;
 	}
 }
 
+fptr_following_cluster(fptr, next_cluster)
+char	fptr;
+char*	next_cluster;
+{
+	/* Find the cluster that follows the current cluster of an open file - from
+	its extent map if it has one, otherwise by reading the FAT.
+	
+		Input:
+			char fptr			- An existing open file pointer
+			char* next_cluster	- pointer to 32bit value to hold the next cluster number
+			
+		Output:
+			0 on success
+			ERR_END_OF_CHAIN if the current cluster is the last of the file
+			ERR_IO_ERROR on read failure
+	*/
+	
+	#ifdef FILE_EXTENTS
+	if (file_extent_count[fptr] != 0){
+		return fptr_extent_cluster(fptr, fptr_get_int16(fptr, FILE_Cur_Cluster_Count_os) + 1, next_cluster);
+	}
+	#endif
+	return get_fat_entry(fptr_cluster_num(fptr), next_cluster);
+}
+
+#ifdef FILE_EXTENTS
+fptr_build_extents(fptr)
+char	fptr;
+{
+	/* Follow the cluster chain of a newly opened file once, recording it in the extent 
+	map of the file pointer as runs of consecutive clusters, and counting the total 
+	number of clusters in the file.
+	
+	If the file is in more than FILE_EXTENTS_MAX pieces (or has more clusters than
+	the 16bit cluster counters can hold) no map is kept, and the file is read by 
+	following the chain in the FAT as usual.
+	
+		Input:
+			char fptr	- An open file pointer, positioned at the start of the file
+			
+		Output:
+			0 on success (whether or not the file could be mapped)
+			ERR_IO_ERROR on read failure
+	*/
+	
+	char	cluster[4];
+	char	next_cluster[4];
+	char	following_cluster[4];
+	char	n;
+	char	error;
+	int		run;
+	int		total;
+	int		os;
+	
+	file_extent_count[fptr] = 0;
+	
+	/* an empty file has no clusters at all */
+	copy_int32(cluster, fptr_cluster_num(fptr));
+	if (int32_is_zero(cluster)){
+		return 0;
+	}
+	
+	os = fptr * FILE_EXTENT_SIZE * FILE_EXTENTS_MAX;
+	copy_int32(file_extents + os + FILE_EXTENT_Cluster_os, cluster);
+	n = 0;
+	run = 0;
+	total = 0;
+	for (;;){
+		run++;
+		total++;
+		if (total == 0x7FFF){
+			/* too big to map */
+			return 0;
+		}
+		error = get_fat_entry(cluster, next_cluster);
+		if (error == ERR_IO_ERROR){
+			return ERR_IO_ERROR;
+		}
+		if (error == 0){
+			/* is the next cluster the one directly after this one? */
+			copy_int32(following_cluster, cluster);
+			inc_int32(following_cluster);
+			if (memcmp(following_cluster, next_cluster, 4) == 0){
+				/* yes, still in the same extent */
+				copy_int32(cluster, next_cluster);
+				continue;
+			}
+		}
+		
+		/* end of this extent */
+		file_extents[os + FILE_EXTENT_Length_os] = run & 0xff;
+		file_extents[os + FILE_EXTENT_Length_os + 1] = run >> 8;
+		n++;
+		if (error != 0){
+			/* end of the chain */
+			break;
+		}
+		if (n == FILE_EXTENTS_MAX){
+			/* too fragmented to map */
+			return 0;
+		}
+		
+		/* start the next extent */
+		os += FILE_EXTENT_SIZE;
+		copy_int32(file_extents + os + FILE_EXTENT_Cluster_os, next_cluster);
+		copy_int32(cluster, next_cluster);
+		run = 0;
+	}
+	
+	file_extent_count[fptr] = n;
+	fptr_set_int16(fptr, FILE_Total_Clusters_os, total);
+	return 0;
+}
+
+fptr_extent_cluster(fptr, cluster_index, cluster)
+char	fptr;
+int		cluster_index;
+char*	cluster;
+{
+	/* Look up the number of a cluster of an open file in its extent map. 
+	
+		Input:
+			char fptr			- An open file pointer with an extent map
+			int cluster_index	- Which cluster of the file, counting from 0
+			char* cluster		- pointer to 32bit value to hold the cluster number
+			
+		Output:
+			0 on success
+			ERR_END_OF_CHAIN if the file has fewer clusters
+	*/
+	
+	char	n;
+	char	offset[4];
+	int		length;
+	int		os;
+	
+	os = fptr * FILE_EXTENT_SIZE * FILE_EXTENTS_MAX;
+	for (n = 0; n < file_extent_count[fptr]; n++){
+		length = (file_extents[os + FILE_EXTENT_Length_os + 1] << 8) + file_extents[os + FILE_EXTENT_Length_os];
+		if (cluster_index < length){
+			/* it's in this extent */
+			int16_to_int32(offset, cluster_index);
+			add_int32(cluster, file_extents + os + FILE_EXTENT_Cluster_os, offset);
+			return 0;
+		}
+		cluster_index = cluster_index - length;
+		os += FILE_EXTENT_SIZE;
+	}
+	return ERR_END_OF_CHAIN;
+}
+#endif
+
+fptr_first_cluster(fptr, cluster)
+char	fptr;
+char*	cluster;
+{
+	/* Copy the starting cluster number of an open file from its directory entry.
+	
+		Input:
+			char fptr		- An existing open file pointer
+			char* cluster	- pointer to 32bit value to hold the cluster number
+	*/
+	
+	memcpy(cluster, fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_FstClusLO_os, 2);
+	memcpy(cluster + 2, fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os + DIR_FstClusHI_os, 2);
+}
+
+#ifdef FILE_CHECKPOINTS
+fptr_build_checkpoints(fptr, table, max_entries)
+char	fptr;
+char*	table;
+int		max_entries;
+{
+	/* Follow the cluster chain of an open file once, recording the number of every 
+	Nth cluster in a checkpoint table. N starts at 1 and each time the table fills up 
+	every other checkpoint is dropped and N is doubled, so the whole file always fits.
+	The total number of clusters in the file is counted at the same time.
+	
+	The current position of the file is not changed.
+	
+		Input:
+			char fptr		- An existing open file pointer
+			char* table		- Memory to hold the table, 4 bytes per checkpoint
+			int max_entries	- Number of checkpoints the table has room for (1 or more)
+			
+		Output:
+			0 on success (a file with more clusters than the 16bit cluster counters 
+				can hold is left without a table)
+			ERR_IO_ERROR on read failure
+	*/
+	
+	char	cluster[4];
+	char	next_cluster[4];
+	char	error;
+	char	shift;
+	int		count;
+	int		total;
+	int		i;
+	
+	file_checkpoints[fptr] = 0;
+	fptr_first_cluster(fptr, cluster);
+	if (int32_is_zero(cluster)){
+		/* an empty file has no clusters at all */
+		return 0;
+	}
+	
+	shift = 0;
+	count = 0;
+	total = 0;
+	for (;;){
+		/* is this cluster a checkpoint? */
+		if ((total & ((1 << shift) - 1)) == 0){
+			if (count == max_entries){
+				/* table full - keep every other checkpoint and double the interval */
+				for (i = 1; (i * 2) < count; i++){
+					copy_int32(table + (i * 4), table + (i * 8));
+				}
+				count = (count + 1) >> 1;
+				shift++;
+			}
+			if ((total & ((1 << shift) - 1)) == 0){
+				copy_int32(table + (count * 4), cluster);
+				count++;
+			}
+		}
+		total++;
+		if (total == 0x7FFF){
+			/* too big to seek within */
+			return 0;
+		}
+		
+		error = get_fat_entry(cluster, next_cluster);
+		if (error == ERR_IO_ERROR){
+			return ERR_IO_ERROR;
+		}
+		if (error != 0){
+			/* end of the chain */
+			break;
+		}
+		copy_int32(cluster, next_cluster);
+	}
+	
+	file_checkpoints[fptr] = table;
+	file_checkpoint_count[fptr] = count;
+	file_checkpoint_shift[fptr] = shift;
+	fptr_set_int16(fptr, FILE_Total_Clusters_os, total);
+	return 0;
+}
+#endif
+
+fptr_seek_cluster(fptr, cluster_index)
+char	fptr;
+int		cluster_index;
+{
+	/* Move the current cluster of an open file to a given cluster of the file.
+	The extent map is used if the file has one, otherwise the cluster chain is 
+	followed - onwards from the current cluster if the wanted cluster is ahead of 
+	it, or from the start of the file if it is behind. With a checkpoint table the
+	chain is instead followed from the nearest checkpoint, when that is closer.
+	
+		Input:
+			char fptr			- An existing open file pointer
+			int cluster_index	- Which cluster of the file, counting from 0
+			
+		Output:
+			0 on success
+			ERR_END_OF_CHAIN if the file has fewer clusters
+			ERR_IO_ERROR on read failure
+	*/
+	
+	char	next_cluster[4];
+	char	error;
+	int		count;
+	#ifdef FILE_CHECKPOINTS
+	char*	table;
+	int		checkpoint;
+	#endif
+	
+	#ifdef FILE_EXTENTS
+	if (file_extent_count[fptr] != 0){
+		if (fptr_extent_cluster(fptr, cluster_index, next_cluster) != 0){
+			return ERR_END_OF_CHAIN;
+		}
+		copy_int32(fptr_cluster_num(fptr), next_cluster);
+		fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, cluster_index);
+		return 0;
+	}
+	#endif
+	
+	count = fptr_get_int16(fptr, FILE_Cur_Cluster_Count_os);
+	
+	#ifdef FILE_CHECKPOINTS
+	if (file_checkpoints[fptr] != 0){
+		/* the last checkpoint at or before the wanted cluster */
+		checkpoint = cluster_index >> file_checkpoint_shift[fptr];
+		if (checkpoint >= file_checkpoint_count[fptr]){
+			checkpoint = file_checkpoint_count[fptr] - 1;
+		}
+		/* start from it, unless we're already between it and the wanted cluster */
+		if ((cluster_index < count) || ((checkpoint << file_checkpoint_shift[fptr]) > count)){
+			table = file_checkpoints[fptr];
+			copy_int32(fptr_cluster_num(fptr), table + (checkpoint * 4));
+			count = checkpoint << file_checkpoint_shift[fptr];
+			fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, count);
+		}
+	}
+	#endif
+	
+	if (cluster_index < count){
+		/* behind us, start again from the first cluster */
+		fptr_first_cluster(fptr, fptr_cluster_num(fptr));
+		count = 0;
+		fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, count);
+	}
+	while (count < cluster_index){
+		error = get_fat_entry(fptr_cluster_num(fptr), next_cluster);
+		if (error != 0){
+			return error;
+		}
+		copy_int32(fptr_cluster_num(fptr), next_cluster);
+		count++;
+		fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, count);
+	}
+	return 0;
+}
+
 fptr_get_next_sector(fptr)
 char	fptr;
 {
@@ -432,36 +1197,179 @@ char	fptr;
 		Output:
 			0 on success
 			Non-zero on error or no further sectors
-			
-		TO BE IMPLEMENTED!!!
-	
 	*/
 	
+	int		sector_count;
+	char	next_cluster[4];
+	
 	/* Check if any further sectors in the current cluster */
-	if (fptr_cluster_sector_pos(fptr) < fs_sectors_per_cluster){
+	sector_count = fptr_cluster_sector_pos(fptr) + 1;
+	if (sector_count < FS_SECTORS_PER_CLUSTER){
 		/* Yes, just update to next sector */
 		/* Update cluster sector pos - i.e. sector 12 of 16 -> 13 of 16 */
-		fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_Count_os);
+		fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, sector_count);
 		/* Update sector LBA address - i.e. 00003078 -> 00003079 */
-		inc_int32(fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_os));
-		/* Set sector buffer pos to zero */
-		memcpy(fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_PosInBuffer_os), 0x0000, 2);
-		return 0;
+		inc_int32(fptr_sector_num(fptr));
 	} else {
 		/* No, but are there any more clusters? */
-	
-		/* Yes, update to that cluster */
-			/* Update cluster sector pos - i.e. sector 12 of 16 -> 13 of 16 */
-		/*	memcpy(fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_Count_os));*/
-			/* Update sector LBA address - i.e. 00003078 -> 00003079 */
-		/*	inc_int32(fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_os));*/
-			/* Set sector buffer pos to zero */
-		/*	memcpy(fwa + ((fptr * FILE_WORK_SIZE) + FILE_Cur_PosInBuffer_os), 0x0000, 2);*/
+		if (fptr_following_cluster(fptr, next_cluster) != 0){
+			/* No, this must be end of file */
+			return 1;
+		}
+		copy_int32(fptr_cluster_num(fptr), next_cluster);
+		/* Yes, the cluster number has been updated - i.e. cluster 4 of 10 -> 5 of 10 */
+		fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, fptr_get_int16(fptr, FILE_Cur_Cluster_Count_os) + 1);
 		/* Update to the first sector of that cluster */
-		
-		/* No, this must be end of file */
-		return 1;
+		fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, 0);
+		get_sector_for_cluster(fptr_sector_num(fptr), fptr_cluster_num(fptr));
+	}
+	/* Set sector buffer pos to zero */
+	fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, 0);
+	return 0;
+}
+
+fptr_get_sector_run(fptr, max_sectors)
+char	fptr;
+int		max_sectors;
+{
+	/* Starting at the current sector of an open file, count how many of the following 
+	sectors are stored consecutively on disk - within the current cluster, or across 
+	clusters that follow each other in the FAT - so that they can be fetched with a single
+	multiple block read.
+	
+	The file position is moved on to the last sector of the run.
+	
+		Input:
+			char fptr		- An existing open file pointer
+			int max_sectors	- The most sectors the caller wants (1 - 255)
+			
+		Output:
+			int				- number of consecutive sectors, from 1 to max_sectors
+	*/
+	
+	int		run;
+	int		sector_count;
+	char	next_cluster[4];
+	char	following_cluster[4];
+	
+	run = 1;
+	while (run < max_sectors){
+		sector_count = fptr_cluster_sector_pos(fptr) + 1;
+		if (sector_count < FS_SECTORS_PER_CLUSTER){
+			/* Next sector is in the same cluster */
+			fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, sector_count);
+		} else {
+			/* Next sector is in another cluster, is it the one directly after this one? */
+			if (fptr_following_cluster(fptr, next_cluster) != 0){
+				return run;
+			}
+			copy_int32(following_cluster, fptr_cluster_num(fptr));
+			inc_int32(following_cluster);
+			if (memcmp(following_cluster, next_cluster, 4) != 0){
+				return run;
+			}
+			/* Yes - move to it without needing to look up its sector address */
+			copy_int32(fptr_cluster_num(fptr), next_cluster);
+			fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, fptr_get_int16(fptr, FILE_Cur_Cluster_Count_os) + 1);
+			fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, 0);
+		}
+		inc_int32(fptr_sector_num(fptr));
+		run++;
+	}
+	return run;
+}
+
+#ifdef BLOCK_CACHE
+fptr_read_ahead(fptr)
+char	fptr;
+{
+	/* Read the current sector of an open file, and as many as file_readahead[fptr] 
+	of the sectors after it, into the block cache with one multiple block read. 
+	Only sectors that are consecutive on disk are read, and never past the end of 
+	the file. The file position is not changed.
+	
+		Input:
+			char fptr	- An existing open file pointer, at the start of a sector
+			
+		Output:
+			0 on success, or if there was nothing to read ahead
+			Non-zero on error
+	*/
+	
+	char	saved_pos[12];
+	char	lba[4];
+	char	rem_bytes_32[4];
+	int		rem_bytes;
+	int		max_sectors;
+	int		run;
+	int		os;
+	
+	max_sectors = file_readahead[fptr] + 1;
+	
+	/* no further than the end of the file */
+	if (sub_int32(rem_bytes_32, fptr_file_size(fptr), fptr_file_pos(fptr)) != 0){
+		return 0;
+	}
+	if ((rem_bytes_32[3] == 0) && (rem_bytes_32[2] == 0) && (rem_bytes_32[1] < 0x80)){
+		rem_bytes = int32_to_int16_lsb(rem_bytes_32);
+		if (((rem_bytes >> SECTOR_SHIFT) + ((rem_bytes & (SECTOR_SIZE - 1)) != 0)) < max_sectors){
+			max_sectors = (rem_bytes >> SECTOR_SHIFT) + ((rem_bytes & (SECTOR_SIZE - 1)) != 0);
+		}
+	}
+	if (max_sectors < 2){
+		return 0;
 	}
+	
+	/* count the consecutive sectors - this moves the position on, so put it back after */
+	os = (fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_Count_os;
+	memcpy(saved_pos, fwa + os, 12);
+	copy_int32(lba, fptr_sector_num(fptr));
+	run = fptr_get_sector_run(fptr, max_sectors);
+	memcpy(fwa + os, saved_pos, 12);
+	if (run < 2){
+		return 0;
+	}
+	
+	return block_cache_fill(lba, run);
+}
+#endif
+
+fptr_get_int16(fptr, field_os)
+char	fptr;
+int		field_os;
+{
+	/* return one of the 2 byte (little-endian) fields of the file work area for a file
+	
+		Input:
+			char fptr		- An existing open file pointer
+			int field_os	- Offset of the field, e.g. FILE_Cur_PosInBuffer_os
+	
+		Output:
+			int		- value of the field
+	*/
+	
+	int	os;
+	os = (fptr * FILE_WORK_SIZE) + field_os;
+	return (fwa[(os + 1)] << 8) + fwa[os];
+}
+
+fptr_set_int16(fptr, field_os, value)
+char	fptr;
+int		field_os;
+int		value;
+{
+	/* set one of the 2 byte (little-endian) fields of the file work area for a file
+	
+		Input:
+			char fptr		- An existing open file pointer
+			int field_os	- Offset of the field, e.g. FILE_Cur_PosInBuffer_os
+			int value		- New value of the field
+	*/
+	
+	int	os;
+	os = (fptr * FILE_WORK_SIZE) + field_os;
+	fwa[os] = value & 0xff;
+	fwa[(os + 1)] = value >> 8;
 }
 
 fptr_cluster_num(fptr)
@@ -489,10 +1397,10 @@ char	fptr;
 			char fptr	- An existing open file pointer
 	
 		Output:
-			char		- the current sector we're reading of this clusterr
+			int		- the current sector we're reading of this cluster
 	*/
 	
-	return fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_Cluster_Count_os;
+	return fptr_get_int16(fptr, FILE_Cur_Sector_Count_os);
 }
 
 fptr_sector_num(fptr)
@@ -522,7 +1430,7 @@ char	fptr;
 			int		- byte pos within the current sector
 	*/
 	
-	return fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_PosInBuffer_os;
+	return fptr_get_int16(fptr, FILE_Cur_PosInBuffer_os);
 }
 
 fptr_file_name(fptr)
@@ -570,99 +1478,158 @@ char	fptr;
 	return fwa + (fptr * FILE_WORK_SIZE) + FILE_Cur_PosInFile_os;
 }
 
-short_filename_match(fat_name, match_name, l)
-char*	fat_name;
-char*	match_name;
-char l;
+is_short_filename_char(c)
+char	c;
 {
 	/*
-		Attempt to see if two null-terminated strings in memory, of length str_sz
-		are the same, accounting for trailing spaces in either str1 or str2.
+		Test if a character can be part of a short (8+3) filename.
 		
-		This is designed for short (8+3) DOS filenames, where each string
-		can be 0-8 characters, with a suffix of 0-3.
+		Input:
+			char	c	- the character.
+			
+		Returns:
+			1 if it can, 0 if not - control characters, space and " * + , / : ; < = > ? [ \\ ] |
+			are only allowed in long filenames.
+	*/
+	
+	if (c < 0x20){
+		return 0;
+	}
+	switch (c){
+		case ' ':
+		case '"':
+		case '*':
+		case '+':
+		case ',':
+		case '/':
+		case ':':
+		case ';':
+		case '<':
+		case '=':
+		case '>':
+		case '?':
+		case '[':
+		case '\\':
+		case ']':
+		case '|':
+			return 0;
+	}
+	return 1;
+}
+
+short_filename_pack(match_name, fat_name)
+char*	match_name;
+char*	fat_name;
+{
+	/*
+		Convert a DOS filename entered by a user (e.g. "file.txt") to the way it is
+		held in a directory entry (e.g. "FILE    TXT") - the name and extension padded 
+		with spaces to 8 and 3 characters, in upper case. 
 		
-		A filename read from disk can have trailing spaces before the suffix. e.g.
-		FILE    TXT
-		... is the same as:
-		FILE.TXT
-		... entered by a user
+		The filename ends at a null terminator or a directory seperator, so each 
+		name in a path can be converted where it is.
 		
 		Input:
-			char*	fat_name	- pointer to filename string as retrieved from filesystem (embedded spaces, no '.' seperator).
-			char*	match_name	- pointer to a null terminated string we're looking to match.
+			char*	match_name	- pointer to the filename.
+			char*	fat_name	- pointer to DIR_Name_sz bytes to hold the converted name.
 			
 		Returns:
-			1 on match.
-			0 on not matched.
-	*/
-	char	ci;	/* index into 11 char filename */
-	char	cnt;	/* next position to insert a char into space-removed filename */
-	char	a,b;	/* case converted chars of filename */
-	char	shortname[MAX_FILENAME_SIZE]; /* space-removed filename from filesystem */
-		
-	/* Truncate the fat filename to collapse spaces after filenmame 
-	and before extension, after extensions and add null terminator */
-	cnt = 0;
-	for (ci = 1; ci <= MAX_FILENAME_SIZE; ci++){
-		shortname[(ci - 1)] = 0x00;
-	}
-	for (ci = 1; ci <= MAX_FILENAME_SIZE; ci++){
-		/* is it a space? */
-		if (fat_name[(ci - 1)] == ' '){
-			/* yes - are we at less than pos 9 */
-			if (ci < 9){
-				/* yes - is the char as pos 9 a space */
-				if (fat_name[8] == ' '){
-					/* yes - this is the end of the string */
-					shortname[cnt] = '\0';
-					break;
-				} else {
-					/* no - store a '.' and move to pos 9 */
-					shortname[cnt] = '.';
-					cnt++;
-					ci = 8;
-				}
-			} else {
-				/* no - end of string */
-				shortname[cnt] = '\0';
-				break;
-			}
-		} else {
-			/* no - store char */
-			shortname[cnt] = fat_name[(ci - 1)];
-			cnt++;
-			/* if this is pos 11 add the null terminator and exit */
-			if (ci == 12){
-				shortname[cnt] = '\0';
-				break;
-			}
+			0 on success.
+			Non-zero if it isn't a short (8+3) filename, e.g. the name or extension is too long,
+			or it has a character only allowed in long filenames (see is_short_filename_char()).
+	*/
+	
+	char	n;		/* index into match_name */
+	char	ci;		/* index into fat_name */
+	char	c;
+	
+	for (ci = 0; ci < DIR_Name_sz; ci++){
+		fat_name[ci] = ' ';
+	}
+	
+	/* the name, up to the '.' */
+	n = 0;
+	ci = 0;
+	while ((match_name[n] != '\0') && (match_name[n] != 0x2F) && (match_name[n] != 0x5C) && (match_name[n] != '.')){
+		if (ci == 8){
+			return 1;
+		}
+		c = match_name[n];
+		if ((c > 96) && (c < 123)){
+			c = c - 'a' + 'A';
+		} else if (is_short_filename_char(c) == 0){
+			return 1;
 		}
+		fat_name[ci] = c;
+		ci++;
+		n++;
+	}
+	if (ci == 0){
+		/* no name, e.g. "." or ".." */
+		return 1;
 	}
 	
-	for (ci = 0; ci <= MAX_FILENAME_SIZE; ci++){
-		/* Have we reached the null byte of the match string? */
-		if (match_name[ci] != '\0'){
-			/* no */			
-			if ((shortname[ci] > 96) && (shortname[ci] < 123)){
-				a = shortname[ci] - 'a' + 'A';
-			} else {
-				a = shortname[ci];
+	/* the extension, after the '.' */
+	if (match_name[n] == '.'){
+		n++;
+		ci = 8;
+		while ((match_name[n] != '\0') && (match_name[n] != 0x2F) && (match_name[n] != 0x5C)){
+			if ((ci == DIR_Name_sz) || (match_name[n] == '.')){
+				return 1;
 			}
-			
-			if ((match_name[ci] > 96) && (match_name[ci] < 123)){
-				b = match_name[ci] - 'a' + 'A';
-			} else {
-				b = match_name[ci];
-			}	
-			
-			if (a != b) {
-				return 0;
+			c = match_name[n];
+			if ((c > 96) && (c < 123)){
+				c = c - 'a' + 'A';
+			} else if (is_short_filename_char(c) == 0){
+				return 1;
 			}
-		} else {
-			/* yes */
-			return 1;	
+			fat_name[ci] = c;
+			ci++;
+			n++;
 		}
 	}
-	return 1;
+	
+	/* a name really starting with 0xE5 is stored as 0x05, as 0xE5 marks an unused entry */
+	if (fat_name[0] == 0xE5){
+		fat_name[0] = 0x05;
+	}
+	return 0;
+}
+
+short_filename_unpack(fat_name, match_name)
+char*	fat_name;
+char*	match_name;
+{
+	/*
+		Convert a filename held in a directory entry (e.g. "FILE    TXT") to the
+		way a user would enter it (e.g. "FILE.TXT") - the opposite of short_filename_pack().
+		
+		Input:
+			char*	fat_name	- pointer to the DIR_Name_sz bytes of the name.
+			char*	match_name	- pointer to MAX_FILENAME_SIZE + 1 bytes to hold the null terminated filename.
+	*/
+	
+	char	n;		/* index into match_name */
+	char	ci;		/* index into fat_name */
+	
+	n = 0;
+	for (ci = 0; (ci < 8) && (fat_name[ci] != ' '); ci++){
+		match_name[n] = fat_name[ci];
+		n++;
+	}
+	if (fat_name[8] != ' '){
+		match_name[n] = '.';
+		n++;
+		for (ci = 8; (ci < DIR_Name_sz) && (fat_name[ci] != ' '); ci++){
+			match_name[n] = fat_name[ci];
+			n++;
+		}
+	}
+	match_name[n] = '\0';
+	
+	/* 0x05 stands in for a name really starting with 0xE5 */
+	if (match_name[0] == 0x05){
+		match_name[0] = 0xE5;
+	}
+	return 0;
 }
@@ -56,14 +56,23 @@ char*	f_path;
 			"1:\music\motoroad.nsf" 
 		
 		The first leading slash always refers to the root directory of the current selected filesystem,
-		so we can look up its directory entries using "fs_root_dir_cluster".
+		so we can look up its directory entries using "fs_root_dir_cluster". A path without one is
+		relative to the working directory set by chdir(), e.g. "shmups/save.dat" - so the directories
+		above it needn't be searched again.
+		
+		If PATH_CACHE is defined, the directory entry of a path that has been opened 
+		recently is taken from the path cache instead, without searching any directories.
+		
+		If LONG_FILENAMES is defined, files and directories can also be given by their 
+		long filenames, e.g. "/games/Bonk's Adventure.pce".
 		
 		Input:
 			char*, f_path		- Pointer to a null terminated string representing the path to a file.
 								Both MS-DOS ("\") and Unix style ("/") directory access is supported - e.g.
 								fopen("/homebrew/utils/data/file.txt")
 								fopen("\games\save1.dat")
-								Access is relative to the root directory of the current open FAT partition. 
+								Access is relative to the root directory of the current open FAT partition,
+								or to the working directory if there is no leading slash.
 								Device names are NOT supported.
 		
 		Returns: 
@@ -71,15 +80,21 @@ char*	f_path;
 			0 on failure and sets global var everdrive_error with status code.
 	*/
 	
-	char filename[MAX_FILENAME_SIZE];
-	char s_start, s_end;
+	int s_start, s_end;
 	char n, fptr;
+	#ifdef PATH_CACHE
+	char fat_name[DIR_Name_sz];	/* the file name, as held in a directory entry */
+	char path_key[PATH_CACHE_KEY_SIZE];
+	char path_dir[4];			/* first cluster of the directory the path starts from */
+	char* entry;
+	int c;
+	#endif
 	
 
 	/* Are any file pointers free? */
 	fptr = 0;
 	/* fptr 0 is reserved for directory access */
-	for (n = 1; n <= NUM_OPEN_FILES; n++) {
+	for (n = 1; n < NUM_OPEN_FILES; n++) {
 		if (file_handles[n] == FPTR_CLOSE_STATUS) {
 			fptr = n;
 			break;
@@ -100,26 +115,60 @@ char*	f_path;
 	while (*f_path == ' '){
 		f_path++;
 	}
-	/* Strip leading directory seperator */
+	/* Strip leading directory seperator, and load the directory entry of the root directory -
+	or of the working directory, if there isn't one - so that we can scan for subdirs and files */
 	if ((*f_path == '/') || (*f_path == '\\' )){
 		f_path++;
+		load_start_directory(0);
+	} else {
+		load_start_directory(1);
 	}
 	
+	#ifdef PATH_CACHE
+	/* Has this path been opened before? Then there's no need to search the directories again */
+	copy_int32(path_dir, fwa + FILE_Cur_Cluster_os);
+	if (path_cache_make_key(f_path, path_dir, path_key) == 0){
+		/* the file name is after the last directory seperator */
+		s_start = 0;
+		for (c = 0; f_path[c] != 0; c++){
+			if ((f_path[c] == 0x2F) || (f_path[c] == 0x5C)){
+				s_start = c + 1;
+			}
+		}
+		if (short_filename_pack(f_path + s_start, fat_name) != 0){
+			/* a long filename - never cached, so neither looked up nor added */
+			path_key[PATH_CACHE_KEY_Len_os] = 0;
+		}
+	} else {
+		/* too long to cache */
+		path_key[PATH_CACHE_KEY_Len_os] = 0;
+	}
+	if (path_key[PATH_CACHE_KEY_Len_os] != 0){
+		entry = path_cache_find(path_key, f_path, path_dir);
+		if (entry != 0){
+			store_directory_entry(entry, fptr, 0);
+			#ifdef FILE_EXTENTS
+			if (fptr_build_extents(fptr) != 0){
+				fclose(fptr);
+				everdrive_error = ERR_IO_ERROR;
+				return 0;
+			}
+			#endif
+			return fptr;
+		}
+	}
+	#endif
+	
 	s_start = 0;
 	s_end = 1;
 	
-	/* Load root directory entry so that we can scan for subdirs and files */
-	store_directory_entry(0, 0, 1);
-	
 	for (;;){
 		/* Is this character a directory seperator */
 		
 		if ((f_path[s_end] == 0x2F) || (f_path[s_end] == 0x5C)){
 			/* Yes, so the string so far is a sub directory of the current dir */		
 			/* find sub dir entry and load it */
-			strncpy(filename, f_path + s_start, (s_end - s_start));
-			filename[(s_end - s_start)] = '\0';
-			if (find_directory_entry(filename, fptr, FILE_TYPE_DIR) == 0){
+			if (find_path_entry(f_path + s_start, fptr, FILE_TYPE_DIR) == 0){
 				/* we then go back around the loop again but searching
 				the found sub directory instead... */
 				/* set start to be end and move both pointers on by +1 */
@@ -137,9 +186,21 @@ char*	f_path;
 			/* Is the path at this point null terminated? */
 			if (f_path[s_end] == 0x00){
 				/* Yes, so it's the actual file name */
-				strncpy(filename, f_path + s_start, (s_end - s_start));
-				filename[(s_end - s_start)] = '\0';
-				if (find_directory_entry(filename, fptr, FILE_TYPE_FILE) == 0){
+				if (find_path_entry(f_path + s_start, fptr, FILE_TYPE_FILE) == 0){
+					#ifdef FILE_EXTENTS
+					/* Map out the cluster chain, so that it needn't be read from the FAT again */
+					if (fptr_build_extents(fptr) != 0){
+						fclose(fptr);
+						everdrive_error = ERR_IO_ERROR;
+						return 0;
+					}
+					#endif
+					#ifdef PATH_CACHE
+					/* Remember where it was found, for the next time it is opened */
+					if (path_key[PATH_CACHE_KEY_Len_os] != 0){
+						path_cache_add(path_key, f_path, path_dir, fwa + (fptr * FILE_WORK_SIZE) + FILE_DIR_os);
+					}
+					#endif
 					/* Return this file pointer */				
 					return fptr;
 				} else {
@@ -153,7 +214,8 @@ char*	f_path;
 				s_end++;	
 			}
 		}
-		if ((s_end - s_start) > MAX_FILENAME_SIZE){
+		if ((s_end - s_start) > MAX_NAME_SIZE){
+			fclose(fptr);
 			everdrive_error = ERR_FILENAME_TOO_LONG;
 			return 0;	
 		}
@@ -183,12 +245,28 @@ char	fptr;
 	 int	n;
 	 
 	 /* Erase buffer memory used by this file */
-	 for (n = ((fptr - 1)* FILE_WORK_SIZE); n< (fptr * FILE_WORK_SIZE); n++) {
+	 for (n = (fptr * FILE_WORK_SIZE); n < ((fptr + 1) * FILE_WORK_SIZE); n++) {
 	 	 fwa[n] = 0x00;
 	 }
 	 
+	 #ifdef FILE_EXTENTS
+	 /* Forget the extent map of this file */
+	 file_extent_count[fptr] = 0;
+	 #endif
+	 
+	 #ifdef BLOCK_CACHE
+	 /* Read-ahead is off for the next file to use this fptr */
+	 file_readahead[fptr] = 0;
+	 zero_int32(file_read_end + (fptr * 4));
+	 #endif
+	 
+	 #ifdef FILE_CHECKPOINTS
+	 /* Forget the checkpoint table of this file - the memory belongs to the caller */
+	 file_checkpoints[fptr] = 0;
+	 #endif
+	 
 	 /* Mark fptr as free */
-	 file_handles[fptr - 1] = FPTR_CLOSE_STATUS;
+	 file_handles[fptr] = FPTR_CLOSE_STATUS;
 	 
 	 return ERR_NONE;
 }
@@ -213,158 +291,141 @@ int	n_bytes;
 			int, n_bytes 	- Number of bytes to read from the file into memory.
 		
 		Returns: 
-			Non-zero on success (number of bytes reads)
+			Non-zero on success (number of bytes read - less than n_bytes at the end of the file)
 			0 on failure and sets everdrive_error
 	*/
 		
 	/* 
-		did we do a partial read last time?
-			yes
-				do we still own sector_buffer?
-					yes
-						copy remaining bytes to f_buf (eg pos 500 - 512)
-						if we read n_bytes then 
-							return size
-						else
-							decrement n_bytes
-					no
-						set ownsership of sector buffer
-						read entire sector
-						copy bytes from old seek pos to f_buf (eg pos 500 - 512)
-						if we read n_bytes then 
-							return size
-						else
-							decrment n_bytes
-			no
-				skip
-				
-		if n_bytes > 0
-		check if any sectors are left in the current cluster
-			yes
-				increment sector number
-				set ownership of sector buffer
-				read sector
-				copy new bytes to f_buf (eg pos 0 - 116)
-				return size
-			no
-				check if there are any more clusters
+		clamp n_bytes to what is left of the file
+		
+		while there are bytes left to read
+			is the current sector used up?
 				yes
-					set new cluster number
-					get new sector number
-					set ownership of sector_buffer
-					read sector
-					copy new bytes to f_buf (eg pos 0 - 116)
-					return size
+					move to the next sector (following the cluster chain if needed)
+					none left - end of file
+			are we at the start of a sector and want at least 1 whole sector,
+			which isn't already in the sector buffer or block cache?
+				yes
+					count the following sectors that are consecutive on disk,
+					within the cluster and across contiguous clusters
+					read them straight into f_buf - with one multiple block read 
+					if there's more than one, so no copying is needed
 				no
-					send EOF
+					if read-ahead is on, this read carries on from where the last
+					one ended and this sector is not cached, read it and the next
+					few sectors into the block cache in one go
+					read the sector into sector_buffer, unless it already holds it
+					copy the bytes we want from it to f_buf (eg pos 500 - 512)
+			update sector and file position counters
 	*/
 	
-	int xfer_bytes;	
-	int rem_bytes;
-	int os;
-	char rem_bytes_32[4];
-	int buffer_os;
+	int 	xfer_bytes;
+	int 	buffer_pos;
+	int 	run;
+	int 	os;
+	char	rem_bytes_32[4];
+	char	xfer_bytes_32[4];
+	char	lba[4];
+	#ifdef BLOCK_CACHE
+	char	sequential;
+	#endif
 	
 	os = 0;
-	/* restore the sector buffer for our use, if necessary */
-	restore_sector_buffer(fptr);
 	
-	/* only continue if we're not already at the end of the file */
-	if (lt_int32(fptr_file_pos(fptr), fptr_file_size(fptr))){
+	#ifdef BLOCK_CACHE
+	/* Only read ahead if the file is being read sequentially - i.e. this read
+	starts where the last one ended, rather than after an fseek() */
+	sequential = 0;
+	if ((file_readahead[fptr] != 0) && (memcmp(fptr_file_pos(fptr), file_read_end + (fptr * 4), 4) == 0)){
+		sequential = 1;
+	}
+	#endif
+	
+	/* only read as far as the end of the file */
+	if (sub_int32(rem_bytes_32, fptr_file_size(fptr), fptr_file_pos(fptr)) != 0){
+		return 0;
+	}
+	int16_to_int32(xfer_bytes_32, n_bytes);
+	if (lt_int32(rem_bytes_32, xfer_bytes_32)){
+		n_bytes = int32_to_int16_lsb(rem_bytes_32);
+	}
+	
+	while (n_bytes > 0){
+		buffer_pos = fptr_sector_pos(fptr);
 		
-		/* Did we do a partial read last time? */ 
-		rem_bytes = (fs_sector_size - 1) - fptr_sector_pos(fptr);
-		if (rem_bytes > 0){
-			/* Yes, so we should read the rem_bytes remaining bytes from this sector first */
-			everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fptr_sector_num(fptr)), int32_to_int16_msb(fptr_sector_num(fptr)), sector_buffer);
-			if (everdrive_error != ERR_NONE){
-				return ERR_IO_ERROR;
+		/* Is the current sector used up? */
+		if (buffer_pos == SECTOR_SIZE){
+			/* any sectors left in current cluster, or any more clusters? */
+			if (fptr_get_next_sector(fptr) != 0){
+				/* Cannot move to next sector - end of file */
+				#ifdef BLOCK_CACHE
+				copy_int32(file_read_end + (fptr * 4), fptr_file_pos(fptr));
+				#endif
+				return os;
 			}
-			
-			/* is the number of bytes requested less than that remaining in this sector? */
-			if (rem_bytes < n_bytes){
-				xfer_bytes = rem_bytes;
+			buffer_pos = 0;
+		}
+		
+		if ((buffer_pos == 0) && (n_bytes >= SECTOR_SIZE) && (sector_is_cached(fptr_sector_num(fptr)) == 0)){
+			/* One or more whole sectors wanted - read as many of them as are
+			consecutive on disk directly into the users output buffer, with a
+			single multiple block read if there are several */
+			copy_int32(lba, fptr_sector_num(fptr));
+			run = fptr_get_sector_run(fptr, n_bytes >> SECTOR_SHIFT);
+			if (run == 1){
+				everdrive_error = disk_read_single_sector(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), f_buf + os);
 			} else {
-				xfer_bytes = n_bytes;
+				everdrive_error = disk_read_sectors(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), run, f_buf + os);
 			}
+			if (everdrive_error != ERR_NONE){
+				return 0;
+			}
+			xfer_bytes = run << SECTOR_SHIFT;
 			
-			/* copy the requested number of bytes to the users output buffer 
-			and increment f_buf*/
-			buffer_os = fptr_sector_pos(fptr);
-			memcpy(f_buf, sector_buffer + buffer_os, xfer_bytes);
-			os = xfer_bytes;
+			/* position is now at the end of the last sector of the run */
+			fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, SECTOR_SIZE);
+		} else {
+			#ifdef BLOCK_CACHE
+			/* Starting on a sector that has to come from the card? Fetch the next few 
+			with it (if read-ahead is on) - if that fails, the read below tries again */
+			if ((buffer_pos == 0) && sequential && (sector_is_cached(fptr_sector_num(fptr)) == 0)){
+				fptr_read_ahead(fptr);
+			}
+			#endif
 			
-			/* increment sector position counter */
-			int16_to_int32(rem_bytes_32, rem_bytes);
-			add_int32(fptr_sector_pos(fptr), fptr_sector_pos(fptr), xfer_bytes);
+			/* Part of a sector wanted - read it into the sector buffer, if it isn't there already */
+			if (sector_buffer_read(fptr_sector_num(fptr)) != 0){
+				return 0;
+			}
+			sector_buffer_current_fptr = fptr;
 			
-			/* increment file position counter */
-			add_int32(fptr_file_pos(fptr), fptr_file_pos(fptr), xfer_bytes);
+			/* is the number of bytes requested less than that remaining in this sector? */
+			xfer_bytes = SECTOR_SIZE - buffer_pos;
+			if (n_bytes < xfer_bytes){
+				xfer_bytes = n_bytes;
+			}
 			
-			/* decrement the number of bytes we need to read now */
-			n_bytes = n_bytes - xfer_bytes;
-		} 
-		
-		/* We didn't do a partial read last time, or we've just read the remaining bytes 
-		from that sector */
-		
-		/* have we got any more bytes to read? */
-		if (n_bytes > 0){
-			/* Yes, so loop until we have nothing left to read */
-			while (n_bytes > 0){
-				/* any sectors left in current cluster? */
-				if (fptr_get_next_sector(fptr) == 0){
-					/* Ok, is n_bytes > fs_sector_size */
-					if (n_bytes > fs_sector_size){	
-						/* yes, so read a sector, copy it and loop again */
-						everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fptr_sector_num(fptr)), int32_to_int16_msb(fptr_sector_num(fptr)), sector_buffer);
-						if (everdrive_error != ERR_NONE){
-							return ERR_IO_ERROR;
-						}
-						/* copy data to user buffer */
-						memcpy(f_buf + os, sector_buffer, fs_sector_size);
-						/* increment offset for next loop pass */
-						os += fs_sector_size;
-						/* decrement number of bytes still needing to be copied */
-						n_bytes = n_bytes - fs_sector_size;
-						
-						/* update sector position counter - i.e. pos 512 of 512 bytes */
-						add_int32(fptr_sector_pos(fptr), fptr_sector_pos(fptr), xfer_bytes);
-						/* increment file position counter - i.e. pos 128000 of 768000 bytes */
-						add_int32(fptr_file_pos(fptr), fptr_file_pos(fptr), xfer_bytes);
+			/* copy the requested number of bytes to the users output buffer */
+			memcpy(f_buf + os, sector_buffer + buffer_pos, xfer_bytes);
 			
-					} else {
-						/* No, read n_bytes only */
-						everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fptr_sector_num(fptr)), int32_to_int16_msb(fptr_sector_num(fptr)), sector_buffer);
-						if (everdrive_error != ERR_NONE){
-							return ERR_IO_ERROR;
-						}
-						memcpy(f_buf + os, sector_buffer, n_bytes);
-						n_bytes = 0;
-						
-						/* update sector position counter - i.e. pos 512 of 512 bytes */
-						add_int32(fptr_sector_pos(fptr), fptr_sector_pos(fptr), xfer_bytes);
-						/* increment file position counter - i.e. pos 128000 of 768000 bytes */
-						add_int32(fptr_file_pos(fptr), fptr_file_pos(fptr), xfer_bytes);
-						
-					}
-				} else {
-					/* Cannot move to next sector - end of file
-					TO DO !!!
-					*/
-				}
-				/* TO DO !!!
-				everdrive_error = disk_read_single_sector(int32_to_int16_lsb(fptr_sector_num(fptr)), int32_to_int16_msb(fptr_sector_num(fptr)), sector_buffer);
-				if (everdrive_error != ERR_NONE){
-					return ERR_IO_ERROR;
-				}*/	
-			}
-			return n_bytes;
-		} else {
-			/* no, already read all requested bytes */
-			return n_bytes;	
-		}		
+			/* update sector position counter - i.e. pos 500 of 512 bytes */
+			fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, buffer_pos + xfer_bytes);
+		}
+		
+		/* increment offset for next loop pass */
+		os += xfer_bytes;
+		/* decrement number of bytes still needing to be copied */
+		n_bytes = n_bytes - xfer_bytes;
+		
+		/* increment file position counter - i.e. pos 128000 of 768000 bytes */
+		int16_to_int32(xfer_bytes_32, xfer_bytes);
+		add_int32(fptr_file_pos(fptr), fptr_file_pos(fptr), xfer_bytes_32);
 	}
+	#ifdef BLOCK_CACHE
+	/* so that the next read can tell if it carries on from here */
+	copy_int32(file_read_end + (fptr * 4), fptr_file_pos(fptr));
+	#endif
+	return os;
 }
 
 fwrite(fptr, f_buf, n_bytes)
@@ -375,6 +436,10 @@ int	n_bytes;
 	/* 
 		Write a number of bytes from memory to an open file pointer.
 		Increments file pointer position by the number of bytes written.
+		
+		Existing data is overwritten in place - the file is not extended
+		and no new clusters are allocated, so writes stop at the current
+		end of the file. (e.g. a pre-sized save file)
 	
 		Input:
 			char, fptr 		- The number of an open file pointer, as returned by fopen().
@@ -382,9 +447,115 @@ int	n_bytes;
 			int, n_bytes 	- Number of bytes to write to the file from memory.
 		
 		Returns: 
-			0 on success
-			Non-zero error code on failure
+			Non-zero on success (number of bytes written - less than n_bytes at the end of the file)
+			0 on failure and sets everdrive_error
 	*/
+	
+	/*
+		clamp n_bytes to what is left of the file
+		
+		while there are bytes left to write
+			is the current sector used up?
+				yes
+					move to the next sector (following the cluster chain if needed)
+			are we at the start of a sector with at least 1 whole sector to write?
+				yes
+					count the following sectors that are consecutive on disk
+					write them all straight from f_buf with one multiple block write,
+					telling the card up front how many blocks to pre-erase
+					drop any copies of them from the sector buffer / block cache
+				no
+					if only part of the sector changes, read it into sector_buffer
+					copy the new bytes into sector_buffer and write it back
+			update sector and file position counters
+	*/
+	
+	int 	xfer_bytes;
+	int 	buffer_pos;
+	int 	run;
+	int 	os;
+	char	rem_bytes_32[4];
+	char	xfer_bytes_32[4];
+	char	lba[4];
+	
+	os = 0;
+	
+	/* only write as far as the end of the file */
+	if (sub_int32(rem_bytes_32, fptr_file_size(fptr), fptr_file_pos(fptr)) != 0){
+		return 0;
+	}
+	int16_to_int32(xfer_bytes_32, n_bytes);
+	if (lt_int32(rem_bytes_32, xfer_bytes_32)){
+		n_bytes = int32_to_int16_lsb(rem_bytes_32);
+	}
+	
+	while (n_bytes > 0){
+		buffer_pos = fptr_sector_pos(fptr);
+		
+		/* Is the current sector used up? */
+		if (buffer_pos == SECTOR_SIZE){
+			if (fptr_get_next_sector(fptr) != 0){
+				/* Cannot move to next sector - end of file */
+				return os;
+			}
+			buffer_pos = 0;
+		}
+		
+		if ((buffer_pos == 0) && (n_bytes >= SECTOR_SIZE)){
+			/* One or more whole sectors to write - write as many of them as are
+			consecutive on disk directly from the users buffer, with a single 
+			(pre-erased) multiple block write */
+			copy_int32(lba, fptr_sector_num(fptr));
+			run = fptr_get_sector_run(fptr, n_bytes >> SECTOR_SHIFT);
+			sector_buffer_discard(lba, run);
+			everdrive_error = disk_write_sectors(int32_to_int16_lsb(lba), int32_to_int16_msb(lba), run, f_buf + os);
+			if (everdrive_error != ERR_NONE){
+				return 0;
+			}
+			xfer_bytes = run << SECTOR_SHIFT;
+			
+			/* position is now at the end of the last sector of the run */
+			fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, SECTOR_SIZE);
+		} else {
+			/* One sector, or part of one */
+			xfer_bytes = SECTOR_SIZE - buffer_pos;
+			if (n_bytes < xfer_bytes){
+				xfer_bytes = n_bytes;
+			}
+			
+			/* keep the rest of the sector if we're only changing part of it */
+			if (xfer_bytes < SECTOR_SIZE){
+				if (sector_buffer_read(fptr_sector_num(fptr)) != 0){
+					return 0;
+				}
+			}
+			sector_buffer_current_fptr = fptr;
+			
+			/* the buffer only matches the card again once the write has worked */
+			sector_buffer_valid = 0;
+			memcpy(sector_buffer + buffer_pos, f_buf + os, xfer_bytes);
+			everdrive_error = disk_write_sectors(int32_to_int16_lsb(fptr_sector_num(fptr)), int32_to_int16_msb(fptr_sector_num(fptr)), 1, sector_buffer);
+			if (everdrive_error != ERR_NONE){
+				return 0;
+			}
+			copy_int32(sector_buffer_lba, fptr_sector_num(fptr));
+			sector_buffer_valid = 1;
+			#ifdef BLOCK_CACHE
+			block_cache_discard(fptr_sector_num(fptr), 1);
+			#endif
+			
+			/* update sector position counter - i.e. pos 500 of 512 bytes */
+			fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, buffer_pos + xfer_bytes);
+		}
+		
+		os += xfer_bytes;
+		n_bytes = n_bytes - xfer_bytes;
+		
+		/* increment file position counter */
+		int16_to_int32(xfer_bytes_32, xfer_bytes);
+		add_int32(fptr_file_pos(fptr), fptr_file_pos(fptr), xfer_bytes_32);
+	}
+	return os;
 }
 
 /* ===============================
@@ -440,17 +611,522 @@ char	seek_mode;
 		Input:
 			char, fptr 		- The number of an open file pounter, as returned by fopen().
 			char*, fpos		- A 4byte memory location emulating a 32bit integer representing the offset into the file to move the file pointer.
+								For SEEK_CUR and SEEK_END a negative (two's complement) offset moves backwards.
 			char, seek_mode	- One of SEEK_SET, SEEK_CUR, SEEK_END indicating 
 								SEEK_SET: seek from beginning of file
 								SEEK_CUR: seek from current position
 								SEEK_END: seek from end of file
 			
+		Returns: 
+			0 on success
+			Non-zero error code on failure - ERR_INVALID_SEEK if the position is outside of the file
+			(the file position is unchanged), other errors leave the file at its start.
+	*/
+	
+	/*
+		work out the new position in the file and check it's within the file
+		
+		position 0 is the start of the first sector
+		any other position is found as the byte just before it, i.e. the end of a
+		sector that has been used up to that point - so a position at the very end 
+		of the file needs no cluster after the last one:
+			cluster of the file	= (position - 1) / (SECTOR_SIZE x fs_sectors_per_cluster)
+			sector in cluster	= ((position - 1) / SECTOR_SIZE) % fs_sectors_per_cluster
+			byte in sector		= ((position - 1) % SECTOR_SIZE) + 1
+		
+		(SECTOR_SIZE and fs_sectors_per_cluster are powers of 2, so these are all shifts and masks)
+		
+		move to that cluster, only following as much of the chain as needed
+		set the sector address and counters from it
+	*/
+	
+	char	target[4];
+	char	last_byte[4];
+	char	offset[4];
+	char	error;
+	int		cluster_index;
+	int		sector_count;
+	int		buffer_pos;
+	
+	/* work out the new position */
+	if (seek_mode == SEEK_SET){
+		copy_int32(target, fpos);
+	} else if (seek_mode == SEEK_CUR){
+		add_int32(target, fptr_file_pos(fptr), fpos);
+	} else if (seek_mode == SEEK_END){
+		add_int32(target, fptr_file_size(fptr), fpos);
+	} else {
+		return ERR_INVALID_SEEK;
+	}
+	
+	/* must be within the file - a negative offset too far back wraps around and fails this too */
+	if (gt_int32(target, fptr_file_size(fptr))){
+		return ERR_INVALID_SEEK;
+	}
+	
+	if (int32_is_zero(target)){
+		return frewind(fptr);
+	}
+	
+	/* the byte before the new position */
+	copy_int32(last_byte, target);
+	dec_int32(last_byte);
+	buffer_pos = (((last_byte[1] & 0x01) << 8) + last_byte[0]) + 1;
+	
+	/* which sector of the file */
+	div_pow_int32(last_byte, 8);
+	div_pow_int32(last_byte, SECTOR_SHIFT - 8);
+	sector_count = last_byte[0] & (FS_SECTORS_PER_CLUSTER - 1);
+	
+	/* which cluster of the file */
+	div_pow_int32(last_byte, fs_cluster_shift);
+	if ((last_byte[3] != 0) || (last_byte[2] != 0) || (last_byte[1] & 0x80)){
+		/* further than the 16bit cluster counters can reach */
+		return ERR_INVALID_SEEK;
+	}
+	cluster_index = (last_byte[1] << 8) + last_byte[0];
+	
+	/* move to that cluster */
+	error = fptr_seek_cluster(fptr, cluster_index);
+	if (error != 0){
+		frewind(fptr);
+		return error;
+	}
+	
+	/* and the sector within it */
+	get_sector_for_cluster(fptr_sector_num(fptr), fptr_cluster_num(fptr));
+	int16_to_int32(offset, sector_count);
+	add_int32(fptr_sector_num(fptr), fptr_sector_num(fptr), offset);
+	fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, sector_count);
+	
+	/* and the byte within that */
+	fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, buffer_pos);
+	copy_int32(fptr_file_pos(fptr), target);
+	return 0;
+}
+
+#ifdef BLOCK_CACHE
+fsetreadahead(fptr, n_sectors)
+char	fptr;
+int		n_sectors;
+{
+	/* 
+		Set how far ahead an open file reads when it is read sequentially in small pieces.
+		
+		Whenever fread() has to go to the card for a sector it only wants part of, it 
+		also fetches up to n_sectors of the sectors that follow it (as far as they are 
+		consecutive on disk and within the file) into the block cache, with a single 
+		multiple block read. The following freads are then served from memory.
+		
+		This is only done when the file is being read sequentially - when the fread() 
+		starts where the last one on this file ended - so reads after an fseek() 
+		don't fill the cache with sectors that may never be wanted.
+		
+		Input:
+			char, fptr 		- The number of an open file pointer, as returned by fopen().
+			int, n_sectors	- Number of sectors to read ahead, 0 to turn read-ahead off.
+								At most BLOCK_CACHE_SLOTS - 2 (one slot is kept for the FAT, and 
+								one more is read with them) - 2 sectors with the default 4 slots, 
+								14 with the 16 slots of a banked cache (see fat.h).
+		
+		Returns: 
+			The number of sectors that will be read ahead.
+	*/
+	
+	if (n_sectors > (BLOCK_CACHE_SLOTS - 2)){
+		n_sectors = BLOCK_CACHE_SLOTS - 2;
+	}
+	if (n_sectors < 0){
+		n_sectors = 0;
+	}
+	file_readahead[fptr] = n_sectors;
+	return n_sectors;
+}
+#endif
+
+#ifdef FILE_CHECKPOINTS
+fsetseekbuf(fptr, f_buf, n_bytes)
+char	fptr;
+char*	f_buf;
+int		n_bytes;
+{
+	/* 
+		Give an open file a table of seek checkpoints, so that fseek() never needs to
+		follow more than a fixed number of links of its cluster chain - however big or
+		fragmented the file is. Worth using on files too fragmented for the extent map.
+		
+		The cluster chain is read once to fill the table. A checkpoint is kept for every 
+		Nth cluster of the file, with N the smallest power of 2 that lets the table fit 
+		in n_bytes, e.g. a 400 cluster file with a 64 byte (16 entry) table gets one 
+		checkpoint every 32 clusters.
+		
+		Input:
+			char, fptr 		- The number of an open file pointer, as returned by fopen().
+			char*, f_buf 	- Memory for the table - it must stay untouched until the file is 
+								closed, so it is best a global array.
+			int, n_bytes 	- Size of f_buf in bytes (at least 4 - each checkpoint takes 4 bytes).
+		
 		Returns: 
 			0 on success
 			Non-zero error code on failure
 	*/
- 
+	
+	if (n_bytes < 4){
+		return ERR_INVALID_SEEK;
+	}
+	return fptr_build_checkpoints(fptr, f_buf, n_bytes >> 2);
+}
+#endif
+
+/* ===============================
+Working directory
+=============================== */
+
+chdir(d_path)
+char*	d_path;
+{
+	/* 
+		Set the working directory - paths without a leading slash given to fopen(), opendir() 
+		etc are then found from it, without searching the directories above it again.
+		
+		Input:
+			char*, d_path	- Pointer to a null terminated path to a directory, e.g. "/games/japan/",
+								or "shmups" relative to the current working directory. "." and ".." 
+								aren't supported.
+		
+		Returns: 
+			0 on success
+			Non-zero error code on failure - the working directory is then unchanged.
+	*/
+	
+	char	error;
+	char	c;
+	int		n;
+	
+	error = load_directory(d_path);
+	if (error != 0){
+		return error;
+	}
+	copy_int32(cwd_cluster, fwa + FILE_Cur_Cluster_os);
+	
+	/* Remember its path for getcwd() - each name followed by a single '/' */
+	while (*d_path == ' '){
+		d_path++;
+	}
+	if ((*d_path == '/') || (*d_path == '\\')){
+		cwd_path[0] = '/';
+		n = 1;
+	} else {
+		n = 0;
+		while (cwd_path[n] != '\0'){
+			n++;
+		}
+	}
+	while ((n != 0) && (*d_path != '\0')){
+		c = *d_path;
+		if (c == '\\'){
+			c = '/';
+		}
+		if ((c != '/') || (cwd_path[n - 1] != '/')){
+			if (n == (CWD_PATH_SIZE - 2)){
+				/* doesn't fit - the path is no longer known */
+				n = 0;
+			} else {
+				cwd_path[n] = c;
+				n++;
+			}
+		}
+		d_path++;
+	}
+	if ((n != 0) && (cwd_path[n - 1] != '/')){
+		cwd_path[n] = '/';
+		n++;
+	}
+	cwd_path[n] = '\0';
+	return 0;
+}
+
+getcwd(buf, size)
+char*	buf;
+int		size;
+{
+	/* 
+		Get the path of the working directory set by chdir(), e.g. "/games/japan/".
+		
+		Input:
+			char*, buf	- Memory to copy the null terminated path to.
+			int, size	- The size of buf.
+		
+		Returns: 
+			0 on success
+			ERR_FILENAME_TOO_LONG if the path doesn't fit in buf, or was too long to be kept 
+			(longer than CWD_PATH_SIZE).
+	*/
+	
+	int		n;
+	
+	n = 0;
+	while (cwd_path[n] != '\0'){
+		n++;
+	}
+	if ((n == 0) || (n >= size)){
+		return ERR_FILENAME_TOO_LONG;
+	}
+	memcpy(buf, cwd_path, n + 1);
+	return 0;
+}
+
+/* ===============================
+Directory listing
+=============================== */
+
+opendir(d_path)
+char*	d_path;
+{
+	/* 
+		Open a directory, to list its contents with readdir().
+		
+		Input:
+			char*, d_path	- Pointer to a null terminated path to a directory, e.g. "/games/japan/"
+								- "/" is the root directory, "" the working directory set by chdir().
+		
+		Returns: 
+			char, dh	- Number of the open directory handle on success.
+			0 on failure and sets global var everdrive_error with status code.
+	*/
+	
+	char*	dir_work;
+	char	error;
+	char	n, dh;
+	
+	/* Are any directory handles free? */
+	dh = 0;
+	for (n = 0; n < NUM_OPEN_DIRS; n++){
+		if (dir_handles[n] == FPTR_CLOSE_STATUS){
+			dh = n + 1;
+			break;
+		}
+	}
+	if (dh == 0){
+		everdrive_error = ERR_NO_FREE_FILES;
+		return 0;
+	}
+	
+	/* Find the directory - it is loaded into fwa[0] */
+	error = load_directory(d_path);
+	if (error != 0){
+		everdrive_error = error;
+		return 0;
+	}
+	
+	/* Take a copy of it, and start from its first sector */
+	dir_work = dwa + ((dh - 1) * FILE_WORK_SIZE);
+	memcpy(dir_work, fwa, FILE_WORK_SIZE);
+	get_sector_for_cluster(dir_work + FILE_Cur_Sector_LBA_os, dir_work + FILE_Cur_Cluster_os);
+	dir_work[FILE_Cur_Sector_Count_os] = 0;
+	dir_work[FILE_Cur_Sector_Count_os + 1] = 0;
+	dir_work[FILE_Cur_PosInBuffer_os] = 0;
+	dir_work[FILE_Cur_PosInBuffer_os + 1] = 0;
+	dir_handles[dh - 1] = FPTR_OPEN_STATUS;
+	return dh;
+}
+
+readdir(dh, entries, max_entries)
+char	dh;
+char*	entries;
+int		max_entries;
+{
+	/* 
+		Read the next entries of an open directory. 
+		
+		Entries are copied as they are held on disk - FILE_DIR_sz (32) bytes each, 
+		laid out as described in fat.h (name at DIR_Name_os, attributes at DIR_Attr_os, 
+		size at DIR_FileSize_os etc) - see short_filename_unpack() for the name as a string,
+		or readdir_names() for the long filename. Unused and long filename entries, and the 
+		volume label, are skipped.
+		
+		All 16 entries of a sector are decoded from a single read of it, so asking for 16 
+		or more entries at a time lists a directory with one card read per 16 entries.
+		
+		Input:
+			char, dh			- The number of an open directory handle, as returned by opendir().
+			char*, entries		- Memory to copy the entries to, max_entries x FILE_DIR_sz bytes.
+			int, max_entries	- The most entries to return.
+		
+		Returns: 
+			The number of entries copied - 0 at the end of the directory, or on error 
+			(when it sets global var everdrive_error with status code).
+	*/
+	
+	return readdir_names(dh, entries, 0, 0, max_entries);
+}
+
+readdir_names(dh, entries, names, name_size, max_entries)
+char	dh;
+char*	entries;
+char*	names;
+int		name_size;
+int		max_entries;
+{
+	/* 
+		Read the next entries of an open directory, as readdir(), along with the name of each 
+		as a null terminated string - its long filename if it has one and LONG_FILENAMES is 
+		defined, otherwise its 8+3 name, e.g. "FILE.TXT".
+		
+		The parts of a long filename are collected as the sectors are read, so this takes no 
+		more card reads than readdir().
+		
+		Input:
+			char, dh			- The number of an open directory handle, as returned by opendir().
+			char*, entries		- Memory to copy the entries to, max_entries x FILE_DIR_sz bytes.
+			char*, names		- Memory to copy the names to, max_entries x name_size bytes - or 0 for no names.
+			int, name_size		- The space for each name (at least MAX_FILENAME_SIZE + 1) - longer names are cut short.
+			int, max_entries	- The most entries to return.
+		
+		Returns: 
+			The number of entries copied - 0 at the end of the directory, or on error 
+			(when it sets global var everdrive_error with status code).
+	*/
+	
+	char*	dir_work;
+	char*	entry;
+	char*	name;
+	int		pos;
+	int		count;
+	char	error;
+	
+	if ((dh < 1) || (dh > NUM_OPEN_DIRS)){
+		everdrive_error = ERR_DIR_NOT_FOUND;
+		return 0;
+	}
+	if (dir_handles[dh - 1] == FPTR_CLOSE_STATUS){
+		everdrive_error = ERR_DIR_NOT_FOUND;
+		return 0;
+	}
+	dir_work = dwa + ((dh - 1) * FILE_WORK_SIZE);
+	
+	/* Mark the sector buffer as in use for directory access now */
+	restore_sector_buffer(0);
+	#ifdef LONG_FILENAMES
+	lfn_reset();
+	#endif
+	
+	count = 0;
+	everdrive_error = ERR_NONE;
+	while ((count < max_entries) && (dir_handles[dh - 1] != DIR_END_STATUS)){
+		pos = (dir_work[FILE_Cur_PosInBuffer_os + 1] << 8) + dir_work[FILE_Cur_PosInBuffer_os];
+		if (pos == SECTOR_SIZE){
+			/* every entry of this sector has been read, on to the next one */
+			error = dir_next_sector(dir_work);
+			if (error != 0){
+				dir_handles[dh - 1] = DIR_END_STATUS;
+				if (error != ERR_END_OF_CHAIN){
+					everdrive_error = ERR_IO_ERROR;
+				}
+				return count;
+			}
+			pos = 0;
+		}
+		if (sector_buffer_read(dir_work + FILE_Cur_Sector_LBA_os) != 0){
+			everdrive_error = ERR_IO_ERROR;
+			return count;
+		}
+		
+		/* copy out as many of the entries of this sector as wanted */
+		while ((pos < SECTOR_SIZE) && (count < max_entries)){
+			entry = sector_buffer + pos;
+			if (is_end_of_dir(entry)){
+				dir_handles[dh - 1] = DIR_END_STATUS;
+				break;
+			}
+			if (is_empty_dir_entry(entry)){
+				#ifdef LONG_FILENAMES
+				lfn_reset();
+				#endif
+			} else if (is_lfn_dir_entry(entry)){
+				#ifdef LONG_FILENAMES
+				if (names != 0){
+					lfn_collect(entry, 0);
+				}
+				#endif
+			} else if (is_volume_label(entry) == 0){
+				memcpy(entries + (count * FILE_DIR_sz), entry, FILE_DIR_sz);
+				if (names != 0){
+					name = names + (count * name_size);
+					#ifdef LONG_FILENAMES
+					if (lfn_belongs_to(entry)){
+						strncpy(name, lfn_name, name_size - 1);
+						name[name_size - 1] = '\0';
+						lfn_reset();
+					} else {
+						short_filename_unpack(entry + DIR_Name_os, name);
+					}
+					#else
+					short_filename_unpack(entry + DIR_Name_os, name);
+					#endif
+				}
+				count++;
+			}
+			pos = pos + FILE_DIR_sz;
+		}
+		dir_work[FILE_Cur_PosInBuffer_os] = pos & 0xFF;
+		dir_work[FILE_Cur_PosInBuffer_os + 1] = (pos >> 8) & 0xFF;
+	}
+	return count;
+}
+
+closedir(dh)
+char	dh;
+{
+	/* 
+		Close an open directory handle.
+	
+		Input:
+			char, dh	- The number of an open directory handle, as returned by opendir().
+		
+		Returns: 
+			0 on success
+			Non-zero error code on failure
+	*/
+	
+	int		n;
+	
+	if ((dh < 1) || (dh > NUM_OPEN_DIRS)){
+		return ERR_DIR_NOT_FOUND;
+	}
+	for (n = ((dh - 1) * FILE_WORK_SIZE); n < (dh * FILE_WORK_SIZE); n++){
+		dwa[n] = 0x00;
+	}
+	dir_handles[dh - 1] = FPTR_CLOSE_STATUS;
+	return 0;
+}
+
+#ifdef DIR_INDEX
+fdirindex(d_path)
+char*	d_path;
+{
+	/* 
+		Index a directory, so that fopen() can find a file in it with (usually) a single
+		sector read, however many files it holds. The directory is read once to build 
+		the index. Only one directory is indexed at a time - indexing another replaces it.
+		
+		Input:
+			char*, d_path	- Pointer to a null terminated path to a directory, e.g. "/roms/".
+		
+		Returns: 
+			0 on success
+			Non-zero error code on failure
+	*/
+	
+	char	error;
+	
+	error = load_directory(d_path);
+	if (error != 0){
+		return error;
+	}
+	return dir_index_build();
 }
+#endif
 
 fgetpos(fptr)
 char	fptr;
@@ -464,6 +1140,8 @@ char	fptr;
 		Returns: 
 			Returns a pointer [char*] to the 32bit file position counter for this fptr object. 
 	*/	 
+	
+	return fptr_file_pos(fptr);
 }
 
 frewind(fptr)
@@ -480,5 +1158,14 @@ char	fptr;
 			Non-zero error code on failure
 	*/	 
 	
+	/* back to the first cluster of the file */
+	fptr_first_cluster(fptr, fptr_cluster_num(fptr));
+	fptr_set_int16(fptr, FILE_Cur_Cluster_Count_os, 0);
+	
+	/* and the first sector of it, which is yet to be read */
+	get_sector_for_cluster(fptr_sector_num(fptr), fptr_cluster_num(fptr));
+	fptr_set_int16(fptr, FILE_Cur_Sector_Count_os, 0);
+	fptr_set_int16(fptr, FILE_Cur_PosInBuffer_os, 0);
+	zero_int32(fptr_file_pos(fptr));
 	return 0;
 }
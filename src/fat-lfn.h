@@ -0,0 +1,307 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* fat-lfn.h
+* ======
+* Long (VFAT) filenames, so that files can be opened and listed by their real
+* names rather than just their 8+3 aliases. Only built if LONG_FILENAMES is
+* defined.
+*
+* A long name is held in a run of entries just before the 8+3 entry of the
+* file, 13 UCS-2 characters to each, last part first. Each part carries the
+* checksum of the 8+3 name it belongs to. The parts are collected into
+* lfn_name as the sectors of a directory are read, by lfn_collect(), so that
+* the name is complete when its 8+3 entry is reached - there is no need to go
+* back and read a sector again.
+*
+* When looking for a name, a run of parts is only collected if it is the
+* right length - the number of parts is known from the first of them, and the
+* exact length from its contents - and is only compared with the name once
+* the checksum of the 8+3 entry that follows it has been checked.
+*
+* Characters beyond 8 bits are held as '?', which can't be part of a name,
+* so they never match. Names are compared ignoring the case of A-Z.
+*/
+
+#ifdef LONG_FILENAMES
+
+lfn_reset()
+{
+	/* Forget any long filename being collected */
+
+	lfn_len = 0;
+	return 0;
+}
+
+lfn_sum(fat_name)
+char*	fat_name;
+{
+	/*
+		Calculate the checksum of an 8+3 name, as held in the long filename
+		entries that belong to it.
+
+		Input:
+			char*	fat_name	- pointer to the DIR_Name_sz bytes of the name.
+
+		Returns:
+			The 8bit checksum.
+	*/
+
+	char	sum;
+	char	ci;
+
+	sum = 0;
+	for (ci = 0; ci < DIR_Name_sz; ci++){
+		/* rotate right, then add */
+		sum = (((sum & 1) << 7) + (sum >> 1) + fat_name[ci]) & 0xFF;
+	}
+	return sum;
+}
+
+lfn_copy_part(dir_entry, ord)
+char*	dir_entry;
+char	ord;
+{
+	/*
+		Copy the characters of a long filename entry to their place in lfn_name
+		(the null at the end of the name is added by lfn_collect()).
+
+		Input:
+			char*	dir_entry	- pointer to the long filename entry.
+			char	ord			- the number of the part (1 - LFN_MAX_ENTRIES).
+
+		Returns:
+			The number of characters in the part, up to the null that ends the name.
+	*/
+
+	char*	dest;
+	char*	src;
+	char	n;
+
+	dest = lfn_name + ((ord - 1) * LFN_CHARS);
+	for (n = 0; n < LFN_CHARS; n++){
+		if (n < 5){
+			src = dir_entry + LFN_Name1_os + (n * 2);
+		} else if (n < 11){
+			src = dir_entry + LFN_Name2_os + ((n - 5) * 2);
+		} else {
+			src = dir_entry + LFN_Name3_os + ((n - 11) * 2);
+		}
+		if ((src[0] == 0) && (src[1] == 0)){
+			/* end of the name */
+			break;
+		}
+		if (src[1] != 0){
+			dest[n] = '?';
+		} else {
+			dest[n] = src[0];
+		}
+	}
+	return n;
+}
+
+lfn_collect(dir_entry, want_len)
+char*	dir_entry;
+int		want_len;
+{
+	/*
+		Collect a part of a long filename, as the entries of a directory are read in turn.
+
+		Input:
+			char*	dir_entry	- pointer to a long filename entry.
+			int		want_len	- only collect names of this length - 0 to collect every name.
+	*/
+
+	char	ord;
+	int		len;
+
+	ord = dir_entry[LFN_Ord_os];
+	if (ord & LFN_LAST_ENTRY){
+		/* the first entry of a long name - the one with its last characters */
+		lfn_len = 0;
+		ord = ord & 0x1F;
+		if ((ord == 0) || (ord > LFN_MAX_ENTRIES)){
+			return 0;
+		}
+		/* too many or too few parts to be the name we want? */
+		if ((want_len != 0) && (ord != ((want_len + LFN_CHARS - 1) / LFN_CHARS))){
+			return 0;
+		}
+		len = ((ord - 1) * LFN_CHARS) + lfn_copy_part(dir_entry, ord);
+		if ((len == 0) || ((want_len != 0) && (len != want_len))){
+			return 0;
+		}
+		lfn_name[len] = '\0';
+		lfn_len = len;
+		lfn_next = ord - 1;
+		lfn_checksum = dir_entry[LFN_Chksum_os];
+	} else if ((lfn_len != 0) && (ord != 0) && (ord == lfn_next) && (dir_entry[LFN_Chksum_os] == lfn_checksum)){
+		/* the next part of the name being collected */
+		lfn_copy_part(dir_entry, ord);
+		lfn_next--;
+	} else {
+		/* a part out of order - the name is no good */
+		lfn_len = 0;
+	}
+	return 0;
+}
+
+lfn_belongs_to(dir_entry)
+char*	dir_entry;
+{
+	/*
+		Test if the long filename collected so far belongs to an 8+3 directory entry -
+		call for the first 8+3 entry after the long filename entries.
+
+		Input:
+			char*	dir_entry	- pointer to the 8+3 directory entry.
+
+		Returns:
+			1 if it does, the name being in lfn_name, 0 if not.
+	*/
+
+	if (lfn_len == 0){
+		return 0;
+	}
+	if ((lfn_next != 0) || (lfn_sum(dir_entry + DIR_Name_os) != lfn_checksum)){
+		lfn_len = 0;
+		return 0;
+	}
+	return 1;
+}
+
+lfn_compare(name, len)
+char*	name;
+int		len;
+{
+	/*
+		Compare a name with the long filename collected, ignoring case.
+
+		Input:
+			char*	name	- pointer to the name.
+			int		len		- the length of the name.
+
+		Returns:
+			0 if they are the same, non-zero if not.
+	*/
+
+	int		n;
+	char	a, b;
+
+	if (len != lfn_len){
+		return 1;
+	}
+	for (n = 0; n < len; n++){
+		a = lfn_name[n];
+		b = name[n];
+		if ((a > 96) && (a < 123)){
+			a = a - 'a' + 'A';
+		}
+		if ((b > 96) && (b < 123)){
+			b = b - 'a' + 'A';
+		}
+		if (a != b){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+find_lfn_directory_entry(name, len, fptr, file_type)
+char*	name;
+int		len;
+char	fptr;
+char	file_type;
+{
+	/*
+		Searches for an entry in a directory by its long filename - as find_directory_entry().
+
+		Input:
+			char*	name			- pointer to the name, e.g. "Bonk's Adventure.pce".
+			int		len				- the length of the name.
+			char	fptr			- the file pointer we're conducting the search for.
+			const char file_type	- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+
+		Output:
+			0 on success.
+			Non-zero on error or file/directory name not found.
+	*/
+
+	char s;					/* loop counter of the number of sectors per cluster */
+	char d;					/* loop counter for the number of directory entries per sector */
+	char addr[4]; 			/* temporary address buffer */
+	char* entry;			/* the directory entry being compared */
+
+	if ((len == 0) || (len > LFN_MAX_SIZE)){
+		return ERR_FILE_NOT_FOUND;
+	}
+
+	get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
+
+	/* Mark the sector buffer as in use by this file pointer now */
+	restore_sector_buffer(0);
+	lfn_reset();
+
+	for (;;){
+		for (s = 0; s < FS_SECTORS_PER_CLUSTER; s++){
+			if (sector_buffer_read(addr) != 0){
+				return ERR_IO_ERROR;
+			}
+			for (d = 0; d < 16; d++){
+				entry = sector_buffer + (d * FILE_DIR_sz);
+
+				if (is_end_of_dir(entry)){
+					return ERR_END_OF_DIRECTORY;
+
+				} else if (is_empty_dir_entry(entry)){
+					lfn_reset();
+
+				} else if (is_lfn_dir_entry(entry)){
+					/* a part of a long filename - only kept if it is the right length */
+					lfn_collect(entry, len);
+
+				} else if (lfn_belongs_to(entry)){
+					/* the checksum matches - so now compare the name itself */
+					if (lfn_compare(name, len) == 0){
+						if (is_sub_dir(entry)){
+							if (file_type == FILE_TYPE_DIR){
+								store_directory_entry(entry, 0, 0);
+								return 0;
+							}
+						} else if (is_volume_label(entry) == 0){
+							if (file_type == FILE_TYPE_FILE){
+								store_directory_entry(entry, fptr, 0);
+								return 0;
+							}
+						}
+					}
+					lfn_reset();
+				}
+			}
+			inc_int32(addr);
+		}
+		/* lookup and set next cluster */
+		if (get_next_cluster(fwa, 1) != 0){
+			return ERR_END_OF_CHAIN;
+		}
+		get_sector_for_cluster(addr, fwa + FILE_Cur_Cluster_os);
+	}
+}
+
+#endif
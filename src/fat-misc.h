@@ -39,6 +39,7 @@ clearFATBuffers()
 	for (i = 0; i < SECTOR_SIZE ; i++) {
 		sector_buffer[i] = 0x00;
 	}
+	sector_buffer_valid = 0;
 	
 	/* part_entry */
 	for (i = 0; i < 16 ; i++) {
@@ -55,7 +56,34 @@ clearFATBuffers()
 	
 	fs_sector_size = 0;
 	fs_sectors_per_cluster = 0;
+	fs_cluster_shift = 0;
 	lba_addressing = 0;
+	
+	/* FAT sector / block cache - what they held may belong to a different card or partition */
+	#ifdef BLOCK_CACHE
+	block_cache_clear();
+	#else
+	fat_cache_clear();
+	#endif
+	
+	/* Directory search starting point - forget it */
+	zero_int32(dir_resume_dir);
+	
+	/* Working directory - back to the root */
+	zero_int32(cwd_cluster);
+	cwd_path[0] = '/';
+	cwd_path[1] = '\0';
+	
+	/* Path cache, miss cache and directory index - likewise */
+	#ifdef PATH_CACHE
+	path_cache_clear();
+	#endif
+	#ifdef MISS_CACHE
+	miss_cache_clear();
+	#endif
+	#ifdef DIR_INDEX
+	dir_index_clear();
+	#endif
 	return 0;
 }
 
@@ -99,6 +127,8 @@ false_vol()
 		sector_buffer[i] = 0x00;
 	}
 	
+	sector_buffer_valid = 0;
+	
 	/* memory loc / memory value / byte offset */
 	sector_buffer[0] = 0xEB; /* 0x00 */
 	sector_buffer[1] = 0x00;
@@ -0,0 +1,117 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* fat-miss-cache.h
+* ======
+* A cache of names recently found not to be in a directory, so that looking
+* for a file that doesn't exist again (e.g. an optional patch or translation
+* file) needs no card reads at all, rather than a search through every sector
+* of the directory. Only built if MISS_CACHE is defined.
+*
+* Each of the MISS_CACHE_ENTRIES entries holds the first cluster of the
+* directory searched, the 8+3 name looked for (as held in a directory entry)
+* and whether a file or a directory was wanted - a file and a directory can't
+* share a name, but a search for one doesn't find the other. When the cache
+* is full, entries are replaced in turn. Long filenames aren't cached.
+*
+* Nothing in this library adds entries to a directory - fwrite() only ever
+* overwrites file data in place - so a cached miss can't go wrong through it.
+* miss_cache_clear() must be called if the directories on the card are
+* changed by anything else, and is called by clearFATBuffers() whenever a
+* card or partition is mounted.
+*/
+
+#ifdef MISS_CACHE
+
+miss_cache_clear()
+{
+	/*
+		Empty the miss cache.
+		Must be called whenever a name may have been added to a directory,
+		e.g. a new card or partition being mounted.
+	*/
+
+	char	i;
+
+	for (i = 0; i < MISS_CACHE_ENTRIES; i++){
+		zero_int32(miss_cache + (i * MISS_CACHE_ENTRY_SIZE) + MISS_CACHE_Cluster_os);
+	}
+	miss_cache_next = 0;
+	return 0;
+}
+
+miss_cache_find(dir_cluster, fat_name, file_type)
+char*	dir_cluster;
+char*	fat_name;
+char	file_type;
+{
+	/*
+		Test if a name was recently found not to be in a directory.
+
+		Input:
+			char*	dir_cluster		- pointer to the 32bit number of the first cluster of the directory.
+			char*	fat_name		- pointer to the DIR_Name_sz bytes of the name, e.g. "FILE    TXT".
+			char	file_type		- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+
+		Returns:
+			1 if it was, 0 if not.
+	*/
+
+	char	i;
+	char*	entry;
+
+	for (i = 0; i < MISS_CACHE_ENTRIES; i++){
+		entry = miss_cache + (i * MISS_CACHE_ENTRY_SIZE);
+		if ((entry[MISS_CACHE_Type_os] == file_type) && (memcmp(entry + MISS_CACHE_Name_os, fat_name, DIR_Name_sz) == 0)){
+			if (memcmp(entry + MISS_CACHE_Cluster_os, dir_cluster, 4) == 0){
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+miss_cache_add(dir_cluster, fat_name, file_type)
+char*	dir_cluster;
+char*	fat_name;
+char	file_type;
+{
+	/*
+		Remember that a name isn't in a directory, replacing the oldest entry.
+
+		Input:
+			char*	dir_cluster		- pointer to the 32bit number of the first cluster of the directory.
+			char*	fat_name		- pointer to the DIR_Name_sz bytes of the name.
+			char	file_type		- either FILE_TYPE_FILE or FILE_TYPE_DIR.
+	*/
+
+	char*	entry;
+
+	entry = miss_cache + (miss_cache_next * MISS_CACHE_ENTRY_SIZE);
+	miss_cache_next++;
+	if (miss_cache_next == MISS_CACHE_ENTRIES){
+		miss_cache_next = 0;
+	}
+	copy_int32(entry + MISS_CACHE_Cluster_os, dir_cluster);
+	memcpy(entry + MISS_CACHE_Name_os, fat_name, DIR_Name_sz);
+	entry[MISS_CACHE_Type_os] = file_type;
+	return 0;
+}
+
+#endif
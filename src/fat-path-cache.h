@@ -0,0 +1,206 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* fat-path-cache.h
+* ======
+* A cache of the directory entries found by fopen(), so that opening the same
+* path again needs no directory searches at all. Only built if PATH_CACHE is
+* defined.
+*
+* Each of the PATH_CACHE_ENTRIES entries holds the 32 byte directory entry of
+* a file (its start cluster, size and attributes), along with the path it was
+* found by and the first cluster of the directory that path starts from (the
+* root, or the working directory for a relative path). Paths are held with
+* upper and lower case letters and both kinds of slash treated as the same, and
+* only paths of up to PATH_CACHE_PATH_SIZE characters are cached. Paths ending
+* in a long filename aren't cached.
+*
+* Entries are also tagged by a key - a 16bit hash of the path and its starting
+* directory, and the length of the path - so that most entries can be passed
+* over without comparing the whole path. A hit is only returned once both the
+* starting directory and the whole path have been compared. When the cache
+* is full, entries are replaced in turn.
+*
+* fwrite() only ever overwrites file data in place, so it can't make a cached
+* entry wrong. path_cache_clear() must be called if the directories on the
+* card are changed by anything else, and is called by clearFATBuffers()
+* whenever a card or partition is mounted.
+*/
+
+#ifdef PATH_CACHE
+
+path_cache_clear()
+{
+	/*
+		Empty the path cache.
+		Must be called whenever the cached directory entries may no longer match
+		the disk, e.g. a new card or partition being mounted.
+	*/
+
+	char	i;
+
+	for (i = 0; i < PATH_CACHE_ENTRIES; i++){
+		path_cache_key[(i * PATH_CACHE_KEY_SIZE) + PATH_CACHE_KEY_Len_os] = 0;
+	}
+	path_cache_next = 0;
+	return 0;
+}
+
+path_cache_fold(c)
+char	c;
+{
+	/*
+		Fold a character of a path to the form it is cached in.
+
+		Input:
+			char	c	- the character.
+
+		Returns:
+			The character, with a-z in upper case and '\\' as '/'.
+	*/
+
+	if ((c > 96) && (c < 123)){
+		return c - 'a' + 'A';
+	}
+	if (c == '\\'){
+		return '/';
+	}
+	return c;
+}
+
+path_cache_make_key(f_path, dir_cluster, key)
+char*	f_path;
+char*	dir_cluster;
+char*	key;
+{
+	/*
+		Make the cache key of a path.
+
+		Input:
+			char*	f_path		- pointer to a null terminated path, without the leading slash.
+			char*	dir_cluster	- pointer to the 32bit number of the first cluster of the directory the path starts from.
+			char*	key			- pointer to PATH_CACHE_KEY_SIZE bytes to hold the key.
+
+		Returns:
+			0 on success.
+			Non-zero if the path is empty or too long to be cached.
+	*/
+
+	int		hash;
+	int		n;
+
+	hash = 0;
+	for (n = 0; n < 4; n++){
+		hash = ((hash << 5) + hash + dir_cluster[n]) & 0xFFFF;
+	}
+	for (n = 0; f_path[n] != 0; n++){
+		if (n == PATH_CACHE_PATH_SIZE){
+			return 1;
+		}
+		/* hash x 33 + c */
+		hash = ((hash << 5) + hash + path_cache_fold(f_path[n])) & 0xFFFF;
+	}
+	if (n == 0){
+		return 1;
+	}
+	key[PATH_CACHE_KEY_Hash_os] = hash & 0xFF;
+	key[PATH_CACHE_KEY_Hash_os + 1] = (hash >> 8) & 0xFF;
+	key[PATH_CACHE_KEY_Len_os] = n;
+	return 0;
+}
+
+path_cache_find(key, f_path, dir_cluster)
+char*	key;
+char*	f_path;
+char*	dir_cluster;
+{
+	/*
+		Find the cached directory entry of a path.
+
+		Input:
+			char*	key			- pointer to the key of the path, from path_cache_make_key().
+			char*	f_path		- pointer to the path, as given to path_cache_make_key().
+			char*	dir_cluster	- pointer to the 32bit number of the first cluster of the directory the path starts from.
+
+		Returns:
+			Pointer to the FILE_DIR_sz bytes of the directory entry.
+			0 if the path isn't cached.
+	*/
+
+	char	i;
+	char	n;
+	char*	cached;
+
+	for (i = 0; i < PATH_CACHE_ENTRIES; i++){
+		/* the key rules out most entries without looking at the path */
+		if (memcmp(path_cache_key + (i * PATH_CACHE_KEY_SIZE), key, PATH_CACHE_KEY_SIZE) != 0){
+			continue;
+		}
+		if (memcmp(path_cache_dir + (i * 4), dir_cluster, 4) != 0){
+			continue;
+		}
+		cached = path_cache_path + (i * PATH_CACHE_PATH_SIZE);
+		for (n = 0; n < key[PATH_CACHE_KEY_Len_os]; n++){
+			if (cached[n] != path_cache_fold(f_path[n])){
+				break;
+			}
+		}
+		if (n == key[PATH_CACHE_KEY_Len_os]){
+			return path_cache_entry + (i * FILE_DIR_sz);
+		}
+	}
+	return 0;
+}
+
+path_cache_add(key, f_path, dir_cluster, dir_entry)
+char*	key;
+char*	f_path;
+char*	dir_cluster;
+char*	dir_entry;
+{
+	/*
+		Add the directory entry of a path to the cache, replacing the oldest entry.
+
+		Input:
+			char*	key			- pointer to the key of the path, from path_cache_make_key().
+			char*	f_path		- pointer to the path, as given to path_cache_make_key().
+			char*	dir_cluster	- pointer to the 32bit number of the first cluster of the directory the path starts from.
+			char*	dir_entry	- pointer to the FILE_DIR_sz byte directory entry found for it.
+	*/
+
+	char	i;
+	char	n;
+	char*	cached;
+
+	i = path_cache_next;
+	path_cache_next++;
+	if (path_cache_next == PATH_CACHE_ENTRIES){
+		path_cache_next = 0;
+	}
+	memcpy(path_cache_key + (i * PATH_CACHE_KEY_SIZE), key, PATH_CACHE_KEY_SIZE);
+	copy_int32(path_cache_dir + (i * 4), dir_cluster);
+	cached = path_cache_path + (i * PATH_CACHE_PATH_SIZE);
+	for (n = 0; n < key[PATH_CACHE_KEY_Len_os]; n++){
+		cached[n] = path_cache_fold(f_path[n]);
+	}
+	memcpy(path_cache_entry + (i * FILE_DIR_sz), dir_entry, FILE_DIR_sz);
+	return 0;
+}
+
+#endif
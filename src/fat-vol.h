@@ -58,7 +58,7 @@ getFATVol()
 		put_string("CHS", 26, INFO_LINE_START + 1);
 	}
 	put_string("Part Start", 1, INFO_LINE_START + 1);
-	put_hex_count(part_lba_begin, 4, 12, INFO_LINE_START + 1);
+	put_hex_int32(part_lba_begin, 12, INFO_LINE_START + 1);
 	#endif	
 	
 	#ifdef FATDEBUG
@@ -67,6 +67,7 @@ getFATVol()
 	put_hex(addr_low, 4, 17, INFO_LINE_START + 2);
 	#endif
 	everdrive_error = disk_read_single_sector(addr_low, addr_hi, sector_buffer);
+	sector_buffer_valid = 0;
 	if (everdrive_error != ERR_NONE) { 
 		/* disk read error */
 		#ifdef FATDEBUG
@@ -128,7 +129,6 @@ char*	fs_sectors_per_fat;
 	*/
 	
 	memcpy(fs_sectors_per_fat, sector_buffer + FAT_FATSz32_os, FAT_FATSz32_sz);
-	swap_int32(fs_sectors_per_fat);
 	return ERR_NONE;
 	
 }
@@ -209,6 +209,10 @@ getFSSectorSize()
 	if (fs_sector_size == 0) {
 		return ERR_NO_SECT_SIZE_INFO;
 	} 
+	if (fs_sector_size != SECTOR_SIZE) {
+		/* the sector buffers, and the shifts used to address them, are all SECTOR_SIZE bytes */
+		return ERR_NO_SECT_SIZE_INFO;
+	}
 	return ERR_NONE;
 }
 
@@ -216,12 +220,30 @@ getFSSectorClusterSize()
 {
 	/*
 		Retrieve the number of sectors (a 8bit integer) to a filesystem cluster for this filesystem.	
+		FAT only allows a power of 2 (1 - 128), so also set fs_cluster_shift to its log2,
+		letting sector and cluster numbers be converted with shifts instead of multiplies.
+		When built with FAT_FIXED_SECTORS_PER_CLUSTER, a card formatted with any other
+		cluster size is refused.
 	*/
 	
 	fs_sectors_per_cluster = sector_buffer[FAT_SecPerClus_os];
-	if (int32_is_zero(fs_sectors_per_cluster)) {
+	if (fs_sectors_per_cluster == 0) {
 		return ERR_NO_SECT_SIZE_INFO;		
 	}
+	fs_cluster_shift = 0;
+	while ((1 << fs_cluster_shift) < fs_sectors_per_cluster){
+		fs_cluster_shift++;
+	}
+	if ((1 << fs_cluster_shift) != fs_sectors_per_cluster) {
+		/* not a power of 2 - not a valid FAT volume */
+		return ERR_NO_SECT_SIZE_INFO;
+	}
+	#ifdef FAT_FIXED_SECTORS_PER_CLUSTER
+	if (fs_sectors_per_cluster != FAT_FIXED_SECTORS_PER_CLUSTER) {
+		/* the file code was built for a different cluster size, it can't be used on this card */
+		return ERR_WRONG_CLUSTER_SIZE;
+	}
+	#endif
 	return ERR_NONE;
 }
 
@@ -249,7 +271,6 @@ char*	sector_buffer;
 	*/
 	
 	memcpy(fs_root_dir_cluster, sector_buffer + FAT_RootClus_os, FAT_RootClus_sz);
-	swap_int32(fs_root_dir_cluster);
 	if (int32_is_zero(fs_root_dir_cluster)) {
 		return ERR_MISS_ROOT_CLUSTER;		
 	}
@@ -282,7 +303,7 @@ getFATFS()
 	}
 	put_string("Part Start", 1, INFO_LINE_START + 1);
 	put_string("h", 20, INFO_LINE_START + 1);
-	put_hex_count(part_lba_begin, 4, 12, INFO_LINE_START + 1);
+	put_hex_int32(part_lba_begin, 12, INFO_LINE_START + 1);
 	#endif	
 	
 	/* Get the bytes per sector of this FAT filesystem */
@@ -337,14 +358,14 @@ getFATFS()
 	if (error != ERR_NONE){
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 4);
-		put_hex_count(fs_sectors_per_fat, 4, 12, INFO_LINE_START + 4);
+		put_hex_int32(fs_sectors_per_fat, 12, INFO_LINE_START + 4);
 		put_string("Error", 26, INFO_LINE_START + 4);
 		#endif
 		return error;
 	} else {
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 4);
-		put_hex_count(fs_sectors_per_fat, 4, 12, INFO_LINE_START + 4);
+		put_hex_int32(fs_sectors_per_fat, 12, INFO_LINE_START + 4);
 		put_string("OK", 26, INFO_LINE_START + 4);
 		#endif
 	}
@@ -402,14 +423,14 @@ getFATFS()
 	if (error != ERR_NONE){
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 7);
-		put_hex_count(fs_fat_lba_begin, 4, 12, INFO_LINE_START + 7);
+		put_hex_int32(fs_fat_lba_begin, 12, INFO_LINE_START + 7);
 		put_string("Error", 26, INFO_LINE_START + 7);
 		#endif
 		return error;
 	} else {
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 7);
-		put_hex_count(fs_fat_lba_begin, 4, 12, INFO_LINE_START + 7);
+		put_hex_int32(fs_fat_lba_begin, 12, INFO_LINE_START + 7);
 		put_string("OK", 26, INFO_LINE_START + 7);
 		#endif
 	}
@@ -424,14 +445,14 @@ getFATFS()
 	if (error != ERR_NONE){
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 8);
-		put_hex_count(fs_cluster_lba_begin, 4, 12, INFO_LINE_START + 8);
+		put_hex_int32(fs_cluster_lba_begin, 12, INFO_LINE_START + 8);
 		put_string("Error", 26, INFO_LINE_START + 8);
 		#endif
 		return error;
 	} else {
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, INFO_LINE_START + 8);
-		put_hex_count(fs_cluster_lba_begin, 4, 12, INFO_LINE_START + 8);
+		put_hex_int32(fs_cluster_lba_begin, 12, INFO_LINE_START + 8);
 		put_string("OK", 26, INFO_LINE_START + 8);
 		#endif
 	}
@@ -446,14 +467,14 @@ getFATFS()
 	if (error != ERR_NONE){
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, (INFO_LINE_START + 9));
-		put_hex_count(fs_root_dir_cluster, 4, 12, (INFO_LINE_START + 9));
+		put_hex_int32(fs_root_dir_cluster, 12, (INFO_LINE_START + 9));
 		put_string("Error", 26, (INFO_LINE_START + 9));
 		#endif
 		return error;
 	} else {
 		#ifdef FATDEBUG
 		put_number(error, 3, 22, (INFO_LINE_START + 9));
-		put_hex_count(fs_root_dir_cluster, 4, 12, (INFO_LINE_START + 9));
+		put_hex_int32(fs_root_dir_cluster, 12, (INFO_LINE_START + 9));
 		put_string("OK", 26, (INFO_LINE_START + 9));
 		#endif
 	}
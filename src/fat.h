@@ -56,7 +56,9 @@ used by some of the test functions/demos */
 
 /* FAT defaults */
 #define SECTOR_SIZE					512
+#define SECTOR_SHIFT				9		/* log2 of SECTOR_SIZE */
 #define CLUSTER_FAT_ENTRIES_SECT	128
+#define CLUSTER_FAT_ENTRIES_SHIFT	7		/* log2 of CLUSTER_FAT_ENTRIES_SECT */
 #define CLUSTER_FAT_ENTRY_SIZE		4
 
 /* MBR/FAT/Volume errors */
@@ -67,6 +69,7 @@ used by some of the test functions/demos */
 #define ERR_NO_RES_SECTORS		150
 #define ERR_NO_FAT_COUNT		151
 #define ERR_NO_SECT_SIZE_INFO	152
+#define ERR_WRONG_CLUSTER_SIZE	161 /* built with FAT_FIXED_SECTORS_PER_CLUSTER and the card has another cluster size */
 
 /* File/directory errors */
 #define ERR_FILE_NOT_FOUND		153
@@ -76,6 +79,7 @@ used by some of the test functions/demos */
 #define ERR_END_OF_DIRECTORY	157
 #define ERR_FILENAME_TOO_LONG	158
 #define ERR_NO_FREE_FILES		159
+#define ERR_INVALID_SEEK		160
 #define	ERR_IO_ERROR			199 /* read 'everdrive_error' for actual error code */
 
 /* ================================================================ */
@@ -186,9 +190,56 @@ used by some of the test functions/demos */
 /* read buffer */
 char	sector_buffer_current_fptr;	/* Which open fptr has data in the sector_buffer (as the buffer may need to be flushed when multiple files are open). */
 char 	sector_buffer[SECTOR_SIZE];	/* Memory to read each sector in from the Turbo Everdrive SD card. */
+char	sector_buffer_lba[4];		/* The LBA address of the sector held in the sector_buffer. */
+char	sector_buffer_valid;		/* Flag to indicate the sector_buffer holds an unchanged copy of the sector at sector_buffer_lba. */
 char	everdrive_error;			/* Hold error codes from low level everdrive routines. */
 char	lba_addressing;				/* Flag to indicate whether LBA addressing (SDHC) or byte addressing (SD) is active. */
 
+/* FAT sector cache - holds the most recently used sectors of the FAT, kept apart from the sector_buffer
+so that following a cluster chain does not throw away buffered file or directory data.
+Not used with the block cache (see below), which caches FAT sectors along with everything else. */
+#ifndef BLOCK_CACHE
+#define FAT_CACHE_ENTRIES		2		/* Set the number of FAT sectors to cache here and multiply by SECTOR_SIZE */
+										/* to get the size of fat_cache, and by 4 to get the size of fat_cache_lba. */
+char	fat_cache[1024];			/* The cached FAT sectors - calculated as FAT_CACHE_ENTRIES x SECTOR_SIZE */
+char	fat_cache_lba[8];			/* The 32bit LBA address of each cached FAT sector - calculated as FAT_CACHE_ENTRIES x 4 */
+char	fat_cache_valid[FAT_CACHE_ENTRIES];	/* Flags to indicate which entries of the FAT cache hold a sector. */
+char	fat_cache_next;				/* The entry of the FAT cache to be replaced on the next miss. */
+#endif
+
+/* Block cache - shared by all sector reads when BLOCK_CACHE is defined, see fat-cache.h */
+#ifdef BLOCK_CACHE
+/* The number of 512 byte slots - 4 in console RAM, or 16 (the whole 8KB) in a RAM bank. To use another number
+(up to 16), define BLOCK_CACHE_SLOTS along with BLOCK_CACHE_LBA_SIZE (BLOCK_CACHE_SLOTS x 4) and
+BLOCK_CACHE_SIZE (BLOCK_CACHE_SLOTS x SECTOR_SIZE). */
+#ifndef BLOCK_CACHE_SLOTS
+#ifdef BLOCK_CACHE_BANK
+#define BLOCK_CACHE_SLOTS		16
+#define BLOCK_CACHE_LBA_SIZE	64
+#define BLOCK_CACHE_SIZE		8192
+#else
+#define BLOCK_CACHE_SLOTS		4
+#define BLOCK_CACHE_LBA_SIZE	16
+#define BLOCK_CACHE_SIZE		2048
+#endif
+#endif
+#define BLOCK_CACHE_NONE		0xFF	/* Not a slot number */
+#ifdef BLOCK_CACHE_BANK
+#ifndef FATHOST
+#define BLOCK_CACHE_BANKED				/* slots are in RAM bank BLOCK_CACHE_BANK - no banks on a host build */
+#endif
+#endif
+#ifndef BLOCK_CACHE_BANKED
+char	block_cache[BLOCK_CACHE_SIZE];	/* The slots - calculated as BLOCK_CACHE_SLOTS x SECTOR_SIZE */
+#endif
+char	block_cache_lba[BLOCK_CACHE_LBA_SIZE];	/* The 32bit LBA address of the sector in each slot - calculated as BLOCK_CACHE_SLOTS x 4 */
+char	block_cache_valid[BLOCK_CACHE_SLOTS];	/* Flags to indicate which slots hold a sector. */
+char	block_cache_age[BLOCK_CACHE_SLOTS];		/* Order in which the slots were last used - 0 is the most recent. */
+char	block_cache_keep;			/* A slot not to be replaced (the FAT sector last used) - or BLOCK_CACHE_NONE. */
+char	block_cache_hits[4];		/* 32bit count of sectors found in the cache. */
+char	block_cache_misses[4];		/* 32bit count of sectors that had to be read from disk. */
+#endif
+
 /* partition entry for the selected/detected partition */
 char	part_entry[16];				/* Holds the partition entry from the master boot record for the current selected partition. */
 char 	part_type;					/* The hex code for the partition type of the current selected partition - only FAT32 are allowed */
@@ -203,6 +254,12 @@ char	fs_num_fats;				/* The number of FAT tables for the current filesystem (sho
 int		fs_reserved_sectors;		/* The number of reserved sectors after the FAT tables and before the data clusters. */
 int		fs_sector_size;				/* The size of a single sector in this filesystem, in bytes. */
 char	fs_sectors_per_cluster;		/* Number of sectors grouped in a single cluster. */
+char	fs_cluster_shift;			/* log2 of fs_sectors_per_cluster - clusters and sectors are converted with shifts and masks. */
+#ifdef FAT_FIXED_SECTORS_PER_CLUSTER
+#define FS_SECTORS_PER_CLUSTER	FAT_FIXED_SECTORS_PER_CLUSTER	/* the one cluster size this build supports - checked at mount time */
+#else
+#define FS_SECTORS_PER_CLUSTER	fs_sectors_per_cluster			/* the cluster size read from the mounted volume */
+#endif
 char	fs_sectors_per_fat[4];		/* How many sectors does each FAT table take up. */
 char	fs_root_dir_cluster[4];		/* Location of the first cluster of the root directory entry - from here you can scan for sub directories and files. */
 
@@ -211,9 +268,15 @@ char	fs_root_dir_cluster[4];		/* Location of the first cluster of the root direc
 /* status types for closed/available and  open/used file pointers */
 #define FPTR_OPEN_STATUS		0xFF	/* value set in the file pointer array when a fptr is open/in-use */
 #define FPTR_CLOSE_STATUS		0x00	/* value set in the file pointer array when a fptr is closed/free */
+#define DIR_END_STATUS			0x01	/* value set in the directory handle array when a directory is open and has been read to the end */
 #define FILE_TYPE_FILE			0x1		/* constant for find_directory_entry when looking for file entry */
 #define FILE_TYPE_DIR			0x2		/* constant for find_directory_entry when looking for dir entry */
 #define MAX_FILENAME_SIZE		12		/* old DOS 8+3 format (including '.' seperator */
+#ifdef LONG_FILENAMES
+#define MAX_NAME_SIZE			LFN_MAX_SIZE		/* longest name of a file or directory in a path */
+#else
+#define MAX_NAME_SIZE			MAX_FILENAME_SIZE
+#endif
 
 /* ============================================================ */
 
@@ -238,6 +301,16 @@ char	fs_root_dir_cluster[4];		/* Location of the first cluster of the root direc
 #define DIR_FileSize_os 	0x1C
 #define DIR_FileSize_sz 	4		/* Size of the file in bytes. */
 
+/* long filename entry structure - a long name is held in up to 20 of these, in reverse
+order, just before the 8+3 directory entry of the file (see fat-lfn.h) */
+#define LFN_Ord_os			0x00	/* Number of this part of the name - 1 for the first 13 characters. */
+#define LFN_LAST_ENTRY		0x40	/* Set in LFN_Ord of the last part, which is held first. */
+#define LFN_Name1_os		0x01	/* Characters 1-5 of the part, in UCS-2 (16bit little-endian). */
+#define LFN_Chksum_os		0x0D	/* Checksum of the 8+3 name of the entry the long name belongs to. */
+#define LFN_Name2_os		0x0E	/* Characters 6-11 of the part. */
+#define LFN_Name3_os		0x1C	/* Characters 12-13 of the part. */
+#define LFN_CHARS			13		/* characters in each part */
+
 /* ============================================================= */
 
 /* FAT entry structure
@@ -289,23 +362,167 @@ char	fwa[104];							/* metadata for all possible open files -
 											calculated as FILE_WORK_SIZE x NUM_OPEN_FILES
 											maximum allowed size is 32768 bytes */
 
+char	dir_resume_dir[4];					/* first cluster of the directory the last file was found in by find_directory_entry() - 0 if none */
+char	dir_resume_cluster[4];				/* where in that directory it was found, for the next search to start from - the cluster, */
+char	dir_resume_sector;					/* the sector of that cluster */
+char	dir_resume_entry;					/* and the entry of that sector */
+
+#define NUM_OPEN_DIRS			1	/* Set the number of simultaneous open directories (opendir()) here and multiply the FILE_WORK_SIZE figure */
+									/* to get the total bytes required for the global dwa. */
+
+char	dir_handles[NUM_OPEN_DIRS];			/* stores flags to indicate which directory handles are open - handle 'n' is dir_handles[n - 1]. */
+char	dwa[52];							/* position of each open directory, laid out as the metadata of a file in fwa -
+											calculated as FILE_WORK_SIZE x NUM_OPEN_DIRS */
+
+#define CWD_PATH_SIZE			64	/* Longest path of the working directory that getcwd() can return, including the null */
+char	cwd_cluster[4];						/* first cluster of the working directory set by chdir() - 0 if not set (by clearFATBuffers()), meaning the root directory */
+char	cwd_path[64];						/* its path, e.g. "/games/japan/" - empty if it didn't fit -
+											calculated as CWD_PATH_SIZE */
+#ifdef BLOCK_CACHE
+char	file_readahead[NUM_OPEN_FILES];		/* number of sectors each open file reads ahead into the block cache - set by fsetreadahead() */
+char	file_read_end[8];					/* 32bit file position at which the last fread() of each open file ended -
+											calculated as NUM_OPEN_FILES x 4 */
+#endif
+
+/* Extent map of each open file - only built by fopen() if FILE_EXTENTS is defined.
+*
+* Each extent records a run of clusters that follow each other on disk, as the first
+* cluster number of the run (4 bytes) and the number of clusters in it (2 bytes).
+* With the map, the cluster holding any position of a file is known without
+* reading the FAT. Files in more pieces than FILE_EXTENTS_MAX are not mapped and
+* fall back to following the cluster chain in the FAT.
+*/
+#ifdef FILE_EXTENTS
+#define FILE_EXTENT_Cluster_os		0x00	/* 4 bytes to hold the number of the first cluster of the extent. */
+#define FILE_EXTENT_Cluster_sz		4
+#define FILE_EXTENT_Length_os		0x04	/* 2 bytes to hold the number of consecutive clusters in the extent. */
+#define FILE_EXTENT_Length_sz		2
+#define FILE_EXTENT_SIZE			6
+#define FILE_EXTENTS_MAX			4		/* Set the number of extents held for each open file here and multiply */
+											/* FILE_EXTENT_SIZE x FILE_EXTENTS_MAX x NUM_OPEN_FILES to get the size of file_extents. */
+
+char	file_extents[48];					/* extent maps for all possible open files */
+char	file_extent_count[NUM_OPEN_FILES];	/* number of extents in the map of each open file - 0 if it has no map */
+#endif
+
+/* Seek checkpoints of each open file - only available if FILE_CHECKPOINTS is defined.
+*
+* A lighter alternative to the extent map for files in too many pieces: fsetseekbuf() 
+* records the cluster number of every Nth cluster of the file in a table provided by 
+* the caller, with N (a power of 2) chosen so that the table fits. fseek() then starts 
+* from the nearest checkpoint and follows at most N-1 links of the cluster chain.
+*/
+#ifdef FILE_CHECKPOINTS
+int		file_checkpoints[NUM_OPEN_FILES];		/* address of the checkpoint table of each open file - 0 if it has none */
+int		file_checkpoint_count[NUM_OPEN_FILES];	/* number of 32bit cluster numbers held in each table */
+char	file_checkpoint_shift[NUM_OPEN_FILES];	/* each table holds every (2 ^ shift)th cluster of the file */
+#endif
+
+/* Path cache - the directory entries of recently opened paths, only built if PATH_CACHE is defined, see fat-path-cache.h */
+#ifdef PATH_CACHE
+#define PATH_CACHE_KEY_Hash_os		0x00	/* 2 bytes to hold the 16bit hash of the path. */
+#define PATH_CACHE_KEY_Hash_sz		2
+#define PATH_CACHE_KEY_Len_os		0x02	/* 1 byte to hold the length of the path - 0 if the entry is unused. */
+#define PATH_CACHE_KEY_Len_sz		1
+#define PATH_CACHE_KEY_SIZE			3
+#define PATH_CACHE_PATH_SIZE		48		/* Longest path that can be cached. */
+#define PATH_CACHE_ENTRIES			8		/* Set the number of cached paths here and multiply by PATH_CACHE_KEY_SIZE, 4, */
+											/* PATH_CACHE_PATH_SIZE and FILE_DIR_sz to get the sizes of the arrays below. */
+
+char	path_cache_key[24];					/* key of each cached path - calculated as PATH_CACHE_ENTRIES x PATH_CACHE_KEY_SIZE */
+char	path_cache_dir[32];					/* first cluster of the directory each path starts from - calculated as PATH_CACHE_ENTRIES x 4 */
+char	path_cache_path[384];				/* each path, in upper case with '/' seperators - calculated as PATH_CACHE_ENTRIES x PATH_CACHE_PATH_SIZE */
+char	path_cache_entry[256];				/* directory entry of each cached path - calculated as PATH_CACHE_ENTRIES x FILE_DIR_sz */
+char	path_cache_next;					/* the entry to be replaced next */
+#endif
+
+/* Miss cache - names recently found not to be in a directory, only built if MISS_CACHE is defined, see fat-miss-cache.h */
+#ifdef MISS_CACHE
+#define MISS_CACHE_Cluster_os		0		/* First cluster of the directory searched - 0 if the entry is unused (4 bytes) */
+#define MISS_CACHE_Name_os			4		/* The 8+3 name looked for, as held in a directory entry (DIR_Name_sz bytes) */
+#define MISS_CACHE_Type_os			15		/* FILE_TYPE_FILE or FILE_TYPE_DIR */
+#define MISS_CACHE_ENTRY_SIZE		16
+#define MISS_CACHE_ENTRIES			8		/* Set the number of names to remember here and multiply by MISS_CACHE_ENTRY_SIZE */
+											/* to get the size of miss_cache. */
+char	miss_cache[128];					/* calculated as MISS_CACHE_ENTRY_SIZE x MISS_CACHE_ENTRIES */
+char	miss_cache_next;					/* Entry to be replaced next. */
+#endif
+
+/* Directory index - hashes of the names in one large directory, only built if DIR_INDEX is defined, see fat-dir-index.h */
+#ifdef DIR_INDEX
+#ifdef DIR_INDEX_BANK
+#ifndef FATHOST
+#define DIR_INDEX_BANKED					/* index is in RAM bank DIR_INDEX_BANK - no banks on a host build */
+#endif
+#define DIR_INDEX_ENTRIES			3584	/* Set the number of directory entries that can be indexed here - a multiple of 16. */
+#else
+#define DIR_INDEX_ENTRIES			128		/* The index takes 2 bytes per entry plus 4 bytes per sector of 16 entries, */
+#endif										/* so multiply by 2.25 to get the size of dir_index. */
+#define DIR_INDEX_LBA_os			(DIR_INDEX_ENTRIES * 2)	/* The LBA address of each sector of the directory follows the hash of each entry. */
+#define DIR_INDEX_NONE				0x0000	/* hash of an unused or long filename entry, or the volume label */
+#ifndef DIR_INDEX_BANKED
+#ifdef DIR_INDEX_BANK
+char	dir_index[8064];					/* The index - calculated as DIR_INDEX_ENTRIES x 2.25 */
+#else
+char	dir_index[288];						/* The index - calculated as DIR_INDEX_ENTRIES x 2.25 */
+#endif
+#endif
+char	dir_index_cluster[4];				/* The first cluster of the indexed directory - 0 if there is no index. */
+int		dir_index_count;					/* Number of entries of the directory held in the index. */
+char	dir_index_complete;					/* 1 if every entry of the directory is in the index. */
+#endif
+
+/* Long filenames - only supported if LONG_FILENAMES is defined, see fat-lfn.h */
+#ifdef LONG_FILENAMES
+#define LFN_MAX_ENTRIES				20		/* Most long filename entries a name can take. */
+#define LFN_MAX_SIZE				255		/* Longest long filename. */
+char	lfn_name[261];						/* The long filename being read - calculated as LFN_CHARS x LFN_MAX_ENTRIES + 1 */
+int		lfn_len;							/* Its length - 0 if there isn't one. */
+char	lfn_next;							/* LFN_Ord of the next part of it to be read - 0 once it is complete. */
+char	lfn_checksum;						/* The checksum of the 8+3 name it belongs to. */
+#endif
+
 /* =========================================================== */
 
-/* low level Everdrive SD interface functions - by MooZ */
+/* low level Everdrive SD interface functions - by MooZ -
+or, when built with -DFATHOST, the disk image backend
+for running the library natively on a host machine */
+#ifdef FATHOST
+#include "fat/sd-host.h"
+#else
 #include "fat/sd.h"
-
-/* emulated '32bit' integer math functions - sector calculation etc */
+#endif
+
+/* emulated '32bit' integer math functions - sector calculation etc -
+define MATH32_ASM to replace the most used ones with the assembly versions
+in math32-asm.h. These haven't been timed on hardware yet (see 06_mathbench),
+so they are opt-in. A host build always uses the C versions. */
+#ifdef FATHOST
+#undef MATH32_ASM
+#endif
 #include "fat/math32.h"
 
-/* little-endian to big-endian conversion functions */
-#include "fat/endian.h"
-
 /* MBR and partition detection routines */
 #include "fat/fat-dev.h"
 
 /* FAT volume data retrieval routines */
 #include "fat/fat-vol.h"
 
+/* Block cache of recently read sectors */
+#include "fat/fat-cache.h"
+
+/* Directory entries of recently opened paths */
+#include "fat/fat-path-cache.h"
+
+/* Names recently found not to be in a directory */
+#include "fat/fat-miss-cache.h"
+
+/* Index of a large directory */
+#include "fat/fat-dir-index.h"
+
+/* Long filenames */
+#include "fat/fat-lfn.h"
+
 /* stdio-like FAT filesytem functions */
 #include "fat/fat-files.h"
 
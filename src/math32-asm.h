@@ -0,0 +1,474 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* math32-asm.h
+* ============
+*
+* Hand written HuC6280 versions of the 32bit math functions that are called
+* for every sector and cluster - used in place of the C versions in math32.h
+* and math32-extras.h when MATH32_ASM is defined (see fat.h).
+*
+* They take the same arguments and return the same values as the C versions,
+* but work directly on the (little-endian) 4 byte arrays with the carry flag
+* rather than with 16bit ints and byte loops.
+*
+* Arguments are read from the HuC stack (the last argument is at [__stack],
+* each argument takes two bytes) and the pointers copied to the zero page
+* registers __si, __di and __bx. Values are returned in X (lsb) and A (msb).
+*
+* add_int32()		- Adds two 32bit numbers, returns the carry
+* sub_int32()		- Subtracts two 32bit numbers, zero and 1 returned if the result would be negative
+* inc_int32()		- Increment a 32bit number by 1
+* dec_int32()		- Decrement a 32bit number by 1
+* lt_int32()		- Is a < b
+* lte_int32()		- Is a <= b
+* gt_int32()		- Is a > b
+* gte_int32()		- Is a >= b
+* shift_int32()		- Shift a 32bit number left by one bit
+* div_pow_int32()	- Divides a 32bit number by a given power of 2
+* mul_pow_int32()	- Multiplies a 32bit number by a given power of 2
+* int32_is_zero()	- Tests if a 32bit number is zero
+* zero_int32()		- Sets a 32bit number to zero
+* copy_int32()		- Copies a 32bit number
+*/
+
+#asm
+    ; Copy the pointer argument at stack offset \1 to the zero page register \2
+m32_arg .macro
+    ldy    #\1
+    lda    [__stack], Y
+    sta    <\2
+    iny
+    lda    [__stack], Y
+    sta    <\2+1
+    .endm
+
+    ; Return the carry flag (\1 = 0) or its inverse (\1 = 1) as 0 or 1
+m32_ret_carry .macro
+    cla
+    rol    a
+    .if \1
+    eor    #1
+    .endif
+    tax
+    cla
+    .endm
+
+    ; Subtract the 32bit number at __bx from the one at __si without storing
+    ; the result - the carry is clear afterwards if it borrowed ([__si] < [__bx])
+m32_compare:
+    cly
+    sec
+    lda    [__si], Y
+    sbc    [__bx], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    rts
+#endasm
+
+add_int32(int32_result, int32_a, int32_b)
+char* 	int32_result;
+char* 	int32_a;
+char* 	int32_b;
+{
+	/*
+		adds and stores the result.
+		Returns 0 on success, 1 on error or overflow.
+	*/
+#asm
+    m32_arg 4, __di
+    m32_arg 2, __si
+    m32_arg 0, __bx
+    ; from the least significant byte (0) up to the most significant (3)
+    cly
+    clc
+    lda    [__si], Y
+    adc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    adc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    adc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    adc    [__bx], Y
+    sta    [__di], Y
+    m32_ret_carry 0
+#endasm
+}
+
+sub_int32(int32_result, int32_a, int32_b)
+char* 	int32_result;
+char* 	int32_a;
+char* 	int32_b;
+{
+	/*
+		Takes two 32bit values, stored as 4 bytes each -
+		subtracts and stores the result.
+
+		Returns 0 on success, 1 on error or overflow (the result is then zeroed).
+	*/
+#asm
+    m32_arg 4, __di
+    m32_arg 2, __si
+    m32_arg 0, __bx
+    cly
+    sec
+    lda    [__si], Y
+    sbc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    sta    [__di], Y
+    iny
+    lda    [__si], Y
+    sbc    [__bx], Y
+    sta    [__di], Y
+    bcs    .ok
+    ; borrow out of the top byte - b was larger than a
+    cla
+    sta    [__di], Y
+    dey
+    sta    [__di], Y
+    dey
+    sta    [__di], Y
+    dey
+    sta    [__di], Y
+.ok:
+    m32_ret_carry 1
+#endasm
+}
+
+inc_int32(int32_result)
+char*	int32_result;
+{
+	/* Increment (in-place) a 32bit number */
+#asm
+    m32_arg 0, __si
+    cly
+.loop:
+    lda    [__si], Y
+    inc    a
+    sta    [__si], Y
+    bne    .done
+    iny
+    cpy    #4
+    bne    .loop
+.done:
+#endasm
+}
+
+dec_int32(int32_result)
+char*	int32_result;
+{
+	/* Decrement (in-place) a 32bit number */
+#asm
+    m32_arg 0, __si
+    cly
+.loop:
+    lda    [__si], Y
+    dec    a
+    sta    [__si], Y
+    cmp    #$FF
+    bne    .done
+    iny
+    cpy    #4
+    bne    .loop
+.done:
+#endasm
+}
+
+lt_int32(int32_a, int32_b)
+char*	int32_a;
+char*	int32_b;
+{
+	/* Boolean - Less Than (a < b) - a - b borrows */
+#asm
+    m32_arg 2, __si
+    m32_arg 0, __bx
+    jsr    m32_compare
+    m32_ret_carry 1
+#endasm
+}
+
+lte_int32(int32_a, int32_b)
+char*	int32_a;
+char*	int32_b;
+{
+	/* Boolean - Less Than or Equal To (a <= b) - b - a doesn't borrow */
+#asm
+    m32_arg 0, __si
+    m32_arg 2, __bx
+    jsr    m32_compare
+    m32_ret_carry 0
+#endasm
+}
+
+gt_int32(int32_a, int32_b)
+char*	int32_a;
+char*	int32_b;
+{
+	/* Boolean - Greater Than (a > b) - b - a borrows */
+#asm
+    m32_arg 0, __si
+    m32_arg 2, __bx
+    jsr    m32_compare
+    m32_ret_carry 1
+#endasm
+}
+
+gte_int32(int32_a, int32_b)
+char*	int32_a;
+char*	int32_b;
+{
+	/* Boolean - Greater Than or Equal To (a >= b) - a - b doesn't borrow */
+#asm
+    m32_arg 2, __si
+    m32_arg 0, __bx
+    jsr    m32_compare
+    m32_ret_carry 0
+#endasm
+}
+
+shift_int32(int32_result)
+char*	int32_result;
+{
+	/* Bitshifts (in-place) a 32bit number left by one bit */
+#asm
+    m32_arg 0, __si
+    cly
+    lda    [__si], Y
+    asl    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+#endasm
+}
+
+div_pow_int32(int32, power)
+char*	int32;
+char	power;
+{
+	/*
+		Divide a 32bit number by a power of 2.
+		e.g. 65536 / 2^7 = 512
+
+		Input:
+			char*	int32	- Pointer to 32bit value in memory.
+			char	power	- The power of 2 to divide by (0 - 8).
+
+		Result:
+			Updates the value of int32. No remainder.
+	*/
+#asm
+    m32_arg 2, __si
+    lda    [__stack]
+    tax
+    beq    .done
+    cpx    #8
+    bne    .loop
+    ; a whole byte - just move the bytes down one place
+    ldy    #1
+    lda    [__si], Y
+    dey
+    sta    [__si], Y
+    ldy    #2
+    lda    [__si], Y
+    dey
+    sta    [__si], Y
+    ldy    #3
+    lda    [__si], Y
+    dey
+    sta    [__si], Y
+    cla
+    iny
+    sta    [__si], Y
+    bra    .done
+.loop:
+    ldy    #3
+    lda    [__si], Y
+    lsr    a
+    sta    [__si], Y
+    dey
+    lda    [__si], Y
+    ror    a
+    sta    [__si], Y
+    dey
+    lda    [__si], Y
+    ror    a
+    sta    [__si], Y
+    dey
+    lda    [__si], Y
+    ror    a
+    sta    [__si], Y
+    dex
+    bne    .loop
+.done:
+#endasm
+}
+
+mul_pow_int32(int32, power)
+char*	int32;
+char	power;
+{
+	/*
+		Multiply a 32bit number by a power of 2.
+		e.g. 4 x 2^7 = 512
+
+		Input:
+			char*	int32	- Pointer to 32bit value in memory.
+			char	power	- The power of 2 to multiply by (0 - 8).
+
+		Result:
+			Updates the value of int32. Bits shifted out of the top are lost.
+	*/
+#asm
+    m32_arg 2, __si
+    lda    [__stack]
+    tax
+    beq    .done
+    cpx    #8
+    bne    .loop
+    ; a whole byte - just move the bytes up one place
+    ldy    #2
+    lda    [__si], Y
+    iny
+    sta    [__si], Y
+    ldy    #1
+    lda    [__si], Y
+    iny
+    sta    [__si], Y
+    cly
+    lda    [__si], Y
+    iny
+    sta    [__si], Y
+    cla
+    dey
+    sta    [__si], Y
+    bra    .done
+.loop:
+    cly
+    lda    [__si], Y
+    asl    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+    iny
+    lda    [__si], Y
+    rol    a
+    sta    [__si], Y
+    dex
+    bne    .loop
+.done:
+#endasm
+}
+
+int32_is_zero(int32)
+char* 	int32;
+{
+	/*
+		Is a packed 4 byte array == 0
+		returns 1 if true, otherwise 0
+	*/
+#asm
+    m32_arg 0, __si
+    lda    [__si]
+    ldy    #1
+    ora    [__si], Y
+    iny
+    ora    [__si], Y
+    iny
+    ora    [__si], Y
+    ; carry is set by any bit being set
+    cmp    #1
+    m32_ret_carry 1
+#endasm
+}
+
+zero_int32(int32_result)
+char*	int32_result;
+{
+	/* Zeroes out a 32bit number */
+#asm
+    m32_arg 0, __si
+    cla
+    sta    [__si]
+    ldy    #1
+    sta    [__si], Y
+    iny
+    sta    [__si], Y
+    iny
+    sta    [__si], Y
+#endasm
+}
+
+copy_int32(int32_result, int32)
+char*	int32_result;
+char*	int32;
+{
+	/* Copies a 32bit number */
+#asm
+    m32_arg 2, __di
+    m32_arg 0, __si
+    ldy    #3
+    lda    [__si], Y
+    sta    [__di], Y
+    dey
+    lda    [__si], Y
+    sta    [__di], Y
+    dey
+    lda    [__si], Y
+    sta    [__di], Y
+    dey
+    lda    [__si], Y
+    sta    [__di], Y
+#endasm
+}
@@ -18,20 +18,23 @@
 //                                                                        
 ////////////////////////////////////////////////////////////////////////////
 * 	
+* Like the original routines, these work on little-endian arrays (byte 0
+* is the least significant), as used by the rest of the library.
 */
 
+#ifndef MATH32_ASM
 dec_int32(int32_result)
 char*	int32_result;
 {
 	/* Decrement (in-place) a 32bit number */
-	if (int32_result[3]--==0) if(int32_result[2]--==0) if (int32_result[1]--==0) --int32_result[0];
+	if (int32_result[0]--==0) if(int32_result[1]--==0) if (int32_result[2]--==0) --int32_result[3];
 }
 
 inc_int32(int32_result)
 char*	int32_result;
 {
 	/* Increment (in-place) a 32bit number */
-	if (int32_result[3]++==0) if(int32_result[2]++==0) if (int32_result[1]++==0) ++int32_result[0];
+	if (++int32_result[0]==0) if(++int32_result[1]==0) if (++int32_result[2]==0) ++int32_result[3];
 }
 
 lt_int32(int32_a, int32_b)
@@ -103,7 +106,7 @@ char*	int32_b;
 shift_int32(int32_result)
 char*	int32_result;
 {
-	/* Bitshifts a 32bit number */
+	/* Bitshifts (in-place) a 32bit number left by one bit */
 	
 	char i, in, out;
 	in = 0;
@@ -113,3 +116,4 @@ char*	int32_result;
 		in = out;
 	}
 }
+#endif
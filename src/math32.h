@@ -24,7 +24,14 @@
 * single byte 'char' and double byte 'int' numbers into 4 byte packed
 * arrays representing 32bit numbers.
 * 
+* The 4 byte arrays are little-endian - byte 0 is the least significant -
+* the same as the FAT structures on disk (and the HuC6280 itself), so 32bit
+* values can be copied straight out of a sector, or used in place.
+* 
 * This is not speed tested. Consider it SLOW.
+* If MATH32_ASM is defined, add/sub/div_pow/mul_pow/is_zero/zero/copy here and the
+* helpers in math32-extras.h are replaced by the hand written HuC6280 versions in
+* math32-asm.h (see fat.h).
 * 
 * Written by John Snowdon (john@target-earth.net), 2014.
 * 
@@ -35,21 +42,26 @@
 * int32_is_zero() 	- Tests if a 4byte 32bit number is zero
 * add_int32() 		- Adds two 4byte 32bit numbers - does not handle overflow
 * sub_int32() 		- SUbtracts two 4byte 32bit numbers - does not handle overflow OR negatives
-* mul_int32() 		- NOT IMPLEMENTED!!!
-* mul_int32_int16()	- SLOW!!! Multiplies a 4byte 32bit number by a 16bit integer - does not handle overflow - needs refactoring
-* mul_int32_int8()	- Multiplies a 4byte 32bit number by a 8bit integer - does not handle overflow - needs refactoring
+* mul_int32() 		- Multiplies two 4byte 32bit numbers by shift and add, reports overflow
+* mul_int32_int16()	- Multiplies a 4byte 32bit number by a 16bit integer, reports overflow
+* mul_int32_int8()	- Multiplies a 4byte 32bit number by a 8bit integer, reports overflow
 * div_pow_int32()	- Divides a 32bit number by a given power of 2. Uses bit shifting.
+* mul_pow_int32()	- Multiplies a 32bit number by a given power of 2. Uses bit shifting.
 * zero_int32()		- Initialises a 4byte packed 32bit number (sets each memory location to 0x00)
 */
 
 #include "fat/math32-extras.h"
 
+#ifdef MATH32_ASM
+#include "fat/math32-asm.h"
+#endif
+
 int32_to_int16_lsb(int32)
 char*	int32;
 {
 	/* returns the 16 least significant bits of a 32bit value as
 	an integer */
-	return (int32[2] << 8) + int32[3];
+	return (int32[1] << 8) + int32[0];
 }
 
 int32_to_int16_msb(int32)
@@ -57,7 +69,7 @@ char*	int32;
 {
 	/* returns the 16 most significant bits of a 32bit value as
 	an integer */
-	return (int32[0] << 8) + int32[1];
+	return (int32[3] << 8) + int32[2];
 }
 
 int8_to_int32(int32_result, int8)
@@ -69,10 +81,10 @@ char 	int8;
 		and converts to the lowest byte of a packed 4 byte array
 	*/
 	
-	int32_result[0] = 0x00;
+	int32_result[0] = int8;
 	int32_result[1] = 0x00;
 	int32_result[2] = 0x00;
-	int32_result[3] = int8;
+	int32_result[3] = 0x00;
 }
 
 int16_to_int32(int32_result, int16)
@@ -84,13 +96,14 @@ int	int16;
 		and converts to the lower two bytes of a packed 4 byte array
 	*/
 	
-	int32_result[0] = 0x00;
-	int32_result[1] = 0x00;
-	int32_result[2] = int16 >> 8;
-	int32_result[3] = int16 & 0xff;
+	int32_result[0] = int16 & 0xff;
+	int32_result[1] = int16 >> 8;
+	int32_result[2] = 0x00;
+	int32_result[3] = 0x00;
 }
 
 
+#ifndef MATH32_ASM
 int32_is_zero(int32)
 char* 	int32;
 {
@@ -103,6 +116,7 @@ char* 	int32;
 	
 	return 0;
 }
+#endif
 
 mul_int32(int32_result, int32_a, int32_b)
 char* 	int32_result;
@@ -112,19 +126,60 @@ char* 	int32_b;
 	/* 
 		Takes two 32bit values, stored as 4 bytes each - 
 		multiplies and stores the result.
-		Clearly a 32bit output cannot hold the product
-		of two 32bit integers, but we just assume that we
-		won't ever be using two values that would bring this about.
-		More likely to be 2 x 16bit values, or a 24bit and 8bit etc.
-		We don't handle overflow.
 		
-		Returns 0 on success, 1 on error or overflow.
+		Shift and add: working down from the most significant set bit
+		of b, the result so far is doubled, and a is added to it for each 
+		bit that is set. So it takes at most 32 shifts and 32 adds, however
+		large the numbers are, and fewer the smaller b is.
+		
+		The result may be the same memory as a or b.
+		
+		Input:
+			char*	int32_result	- Pointer to 32bit location in memory to hold result.
+			char*	int32_a			- Pointer to 32bit number to be multiplied.
+			char*	int32_b			- Pointer to 32bit number to multiply by.
+		
+		Returns:
+			0 on success / no overflow.
+			1 if the product doesn't fit in 32bits - int32_result then holds
+			its least significant 32bits.
 	*/
 	
-	return 0;
-
+	char	a[4];
+	char	r[4];
+	char	i;
+	char	bits;
+	char	mask;
+	char	started;
+	char	overflow;
+	
+	copy_int32(a, int32_a);
+	zero_int32(r);
+	started = 0;
+	overflow = 0;
+	for (i = 4; i > 0; i--){
+		bits = int32_b[(i - 1)];
+		for (mask = 0x80; mask != 0; mask = mask >> 1){
+			if (started){
+				/* doubling would push the top bit out */
+				if (r[3] & 0x80){
+					overflow = 1;
+				}
+				shift_int32(r);
+			}
+			if (bits & mask){
+				if (add_int32(r, r, a) != 0){
+					overflow = 1;
+				}
+				started = 1;
+			}
+		}
+	}
+	copy_int32(int32_result, r);
+	return overflow;
 }
 
+#ifndef MATH32_ASM
 add_int32(int32_result, int32_a, int32_b)
 char* 	int32_result;
 char* 	int32_a;
@@ -136,15 +191,14 @@ char* 	int32_b;
 	*/
 
 	int 	sum;
-	char	i, pos;
+	char	pos;
 	char 	carry;
 		
 	/* zero_int32(int32_result); */
 		
 	carry = 0x00;
 	/* loop over each byte of the 4byte array from lsb to msb */
-	for (i = 1; i < 5; i++) {
-		pos = 4 - i; 
+	for (pos = 0; pos < 4; pos++) {
 		/* sum the two 1 byte numbers as a 2 byte int */
 		sum = int32_a[pos] + int32_b[pos] + carry;
 		/* would integer overflow occur with this sum? */
@@ -177,94 +231,54 @@ char* 	int32_b;
 		Takes two 32bit values, stored as 4 bytes each - 
 		subtracts and stores the result.
 		
-		Returns 0 on success, 1 on error or overflow.
-		
-		TO DO - Really feels like this could be refactored to be
-		a short loop. But it does work as-is.
+		Returns 0 on success, 1 on error or overflow (the result is then zeroed).
 	*/
 	
-	char borrow;
-	char result[4];
-	int sum;
-	
-	/* If the byte 1 of the first integer is smaller than that of the second, then underflow would
-	occur _regardless_ */
-	if (int32_a[0] < int32_b[0]) {	
-		zero_int32(int32_result);
-		return 1;
-	} 	
-	
-	/* byte 4 */
-	if (int32_a[3] >= int32_b[3]){
-		result[3] = int32_a[3] - int32_b[3];
-		borrow = 0;
-	} else {
-		sum = int32_a[3] + 0x0100;
-		result[3] = sum - int32_b[3] - borrow;
-		borrow = 1;
-	}
-	
-	/* byte 3 */
-	if ((int32_a[2] - borrow) >= int32_b[2]){
-		result[2] = (int32_a[2] - int32_b[2]) - borrow;
-		borrow = 0;
-	} else {
-		sum = int32_a[2] + 0x0100;
-		result[2] = sum - int32_b[2] - borrow;
-		borrow = 1;
-	}
+	char	borrow;
+	char	pos;
+	char	result[4];
+	int		diff;
 	
-	/* byte 2 */
-	if ((int32_a[1] - borrow) >= int32_b[1]){
-		result[1] = int32_a[1] - int32_b[1] - borrow;
-		borrow = 0;
-	} else {
-		sum = int32_a[1] + 0x0100;
-		result[1] = sum - int32_b[1] - borrow;
-		borrow = 1;	
+	borrow = 0;
+	/* loop over each byte of the 4byte array from lsb to msb */
+	for (pos = 0; pos < 4; pos++) {
+		diff = int32_a[pos] - int32_b[pos] - borrow;
+		if (diff < 0) {
+			/* borrow from the next byte */
+			diff = diff + 0x0100;
+			borrow = 1;
+		} else {
+			borrow = 0;
+		}
+		result[pos] = diff;
 	}
 	
-	/* byte 1 */
-	if ((int32_a[0] - borrow) >= int32_b[0]){
-		result[0] = int32_a[0] - int32_b[0] - borrow;
-	} else {
+	/* a borrow out of the most significant byte means b was larger than a */
+	if (borrow != 0) {
 		zero_int32(int32_result);
 		return 1;
 	}
-	
 	copy_int32(int32_result, result);
 	return 0;
 }
+#endif
 
 mul_int32_int16(int32_result, int16)
 char*	int32_result;
 int		int16;
 {
 	/* 
-		Multiply a 32bit number by a 16bit number and stores the result
-		as 4 bytes.
+		Multiply (in-place) a 32bit number by an unsigned 16bit number,
+		with the shift and add of mul_int32().
 		
-		This is VERY SLOW (but works) - multiple add_int32 calls, it
-		should be refactored to use bit shifting.
-		
-		TODO: CONVERT TO SHIFT
-		
-		Returns 0 on success, 1 on error or overflow.
+		Returns 0 on success, 1 on overflow (int32_result then holds
+		the least significant 32bits of the product).
 	*/
 	
-	char overflow;
-	int i;
-	char r[4];
-	memcpy(r, int32_result, 4);
-	zero_int32(int32_result);
-
-	for (i = 0; i < int16; i++) {
-		overflow = add_int32(int32_result, int32_result, r);
-		if (overflow != 0){
-			return overflow;
-		}
-	}
-	return 0;
+	char	b[4];
+	
+	int16_to_int32(b, int16);
+	return mul_int32(int32_result, int32_result, b);
 }
 
 mul_int32_int8(int32_result, int32, int8)
@@ -294,7 +308,7 @@ char	int8;
 	int old_v;
 	
 	v = 0;
-	for (i = 3; i > 0; --i){
+	for (i = 0; i < 3; i++){
 		
 		/* multiply and add overflow from last loop*/
 		old_v = (int32[i] * int8) + v;
@@ -305,15 +319,18 @@ char	int8;
 		/* store msb as overflow for next loop */
 		v = (old_v >> 8) & 0xff;
 	}
-	int32_result[0] = (int32[0] * int8) + v;
-	if (int32[0] > int32_result[0]){
-		/* overflow */
+	old_v = (int32[3] * int8) + v;
+	int32_result[3] = old_v & 0xff;
+	if (((old_v >> 8) & 0xff) != 0){
+		/* overflow - the product needs more than 32bits
+		(old_v may be negative as a 16bit int, so test the msb alone) */
 		return 1;
 	} else {
 		return 0;
 	}
 }
 
+#ifndef MATH32_ASM
 div_pow_int32(int32, power)
 char*	int32;
 char	power;
@@ -324,7 +341,7 @@ char	power;
 		
 		Input:
 			char*	int32	- Pointer to 32bit value in memory.
-			char	power	- The power of 2 to divide by.
+			char	power	- The power of 2 to divide by (0 - 8).
 			
 		Result:
 			Updates the value of int32. No remainder.
@@ -333,10 +350,39 @@ char	power;
 	char i;
 	char v, old_v;
 	
+	v = 0;
+	for (i = 4; i > 0; i--){
+		/* the bits shifted out of this byte become the top bits of the next (less significant) byte */
+		old_v = (int32[(i - 1)] << (8 - power));
+		int32[(i - 1)] = (int32[(i - 1)] >> power) + v;
+		v = old_v;
+	}
+}
+
+mul_pow_int32(int32, power)
+char*	int32;
+char	power;
+{
+	/*
+		Multiply a 32bit number by a power of 2.
+		e.g. 4 x 2^7 = 512
+		
+		Input:
+			char*	int32	- Pointer to 32bit value in memory.
+			char	power	- The power of 2 to multiply by (0 - 8).
+			
+		Result:
+			Updates the value of int32. Bits shifted out of the top are lost.
+	*/
+	
+	char i;
+	char v, old_v;
+	
 	v = 0;
 	for (i = 0; i < 4; i++){
-		old_v = (int32[i] << 1);
-		int32[i] = (int32[i] >> power) + v;
+		/* the bits shifted out of this byte become the bottom bits of the next (more significant) byte */
+		old_v = (int32[i] >> (8 - power));
+		int32[i] = (int32[i] << power) + v;
 		v = old_v;
 	}
 }
@@ -360,3 +406,4 @@ char*	int32;
 	
 	memcpy(int32_result, int32, 4);
 }
+#endif
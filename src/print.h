@@ -41,6 +41,28 @@ char	row;
 	return 0;
 }
  
+put_hex_int32(int32, col, row)
+char*	int32;
+char	col;
+char	row;
+{
+	/* 
+		print a 32bit number as 8 hex digits, most significant first
+		(it is stored least significant byte first).
+		
+		Input:
+			char*, int32	- Pointer to 32bit number.
+			char, col	- Start column (text mode).
+			char, row	- Start tow (text mode).
+	*/
+	
+	char hex_byte;
+	for (hex_byte=0; hex_byte<4; hex_byte++) {
+		put_hex(int32[(3 - hex_byte)], 2, col + (2 * hex_byte), row);
+	}
+	return 0;
+}
+ 
 put_string_count(buffer, count, col, row)
 char*	buffer;
 char	count;
@@ -0,0 +1,279 @@
+/*
+* This file is part of everdrive-fat.
+
+* everdrive-fat is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* Foobar is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with everdrive-fat.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+/*
+* sd-host.h
+* =========
+* Host-side replacement for sd.h / sd.asm.
+*
+* Selected at compile time by defining FATHOST. Implements the same
+* entry points as the Everdrive SD driver, but on top of a raw disk
+* image file, so that the FAT library can be built with a native C
+* compiler and run on a normal Linux/Unix machine.
+*
+* The image must contain a DOS MBR with a FAT32 partition, exactly as
+* an SD card would, e.g:
+*
+*	mkfs.fat -F 32 -C --mbr=y card.img 65536
+*
+* Addresses are always treated as sector (LBA) addresses, so the card
+* type reported is SD_V2 with bit 0 (SD_HC) clear - the type sd.asm
+* gives an SDHC card, whose OCR CCS bit is set. sd.asm only sets bit 0
+* for standard cards, whose addresses it converts to bytes.
+*
+* Only the POSIX file calls are used here; the stdio names (fopen,
+* fread, fseek ...) belong to fat-files.h, so <stdio.h> must not be
+* included anywhere in a FATHOST build. Nor must <unistd.h> (chdir,
+* getcwd), so the few calls used from it are declared here.
+*/
+
+#include <string.h>
+#include <fcntl.h>
+
+long	pread();
+long	pwrite();
+int		close();
+
+/* SD card type */
+#define SD_V2 2
+#define SD_HC 1
+
+/* Errors */
+#define ERR_NONE             0
+#define ERR_FILE_TOO_BIG     140
+#define ERR_OS_RISK          141
+#define ERR_WRONG_OS_SIZE    142
+#define ERR_OS_FRAGMENTATION 143
+#define ERR_OS_BAD_TILE      144
+
+#define FAT_ERR_INIT  110
+#define FAT_LFN_ERROR 115
+
+#define DISK_ERR_INIT 50
+#define DISK_ERR_RD1  62
+#define DISK_ERR_RD2  63
+
+#define DISK_ERR_WR1 64
+#define DISK_ERR_WR2 65
+#define DISK_ERR_WR3 66
+#define DISK_ERR_WR4 67
+#define DISK_ERR_WR5 68
+
+int		host_disk_image;		/* File descriptor of the disk image standing in for the SD card (0 == none). */
+long	host_disk_read_cmds;	/* Number of read commands issued to the 'card'. */
+long	host_disk_read_sectors;	/* Number of sectors transferred by those read commands. */
+long	host_disk_write_cmds;	/* Number of write commands issued to the 'card'. */
+long	host_disk_write_sectors;/* Number of sectors transferred by those write commands. */
+
+/**
+ * Open a disk image to use in place of the SD card.
+ * \param [in] path Filename of the raw disk image.
+ * \return
+ *    DISK_ERR_INIT Image could not be opened
+ **/
+host_disk_open(path)
+char*	path;
+{
+	host_disk_image = open(path, O_RDWR);
+	if (host_disk_image < 0) {
+		/* fall back to read-only access */
+		host_disk_image = open(path, O_RDONLY);
+	}
+	if (host_disk_image < 0) {
+		host_disk_image = 0;
+		return DISK_ERR_INIT;
+	}
+	host_disk_reset_stats();
+	return ERR_NONE;
+}
+
+/**
+ * Close the disk image.
+ **/
+host_disk_close()
+{
+	if (host_disk_image != 0) {
+		close(host_disk_image);
+		host_disk_image = 0;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Zero the command and sector counters.
+ **/
+host_disk_reset_stats()
+{
+	host_disk_read_cmds = 0;
+	host_disk_read_sectors = 0;
+	host_disk_write_cmds = 0;
+	host_disk_write_sectors = 0;
+	return ERR_NONE;
+}
+
+/**
+ * Convert a sector address given as two 16 bit words to a byte offset in the image.
+ **/
+long host_disk_offset(addr_lo, addr_hi)
+int addr_lo;
+int addr_hi;
+{
+	long	lba;
+
+	lba = ((long)(addr_hi & 0xffff) << 16) + (long)(addr_lo & 0xffff);
+	return lba * 512;
+}
+
+/**
+ * Enable everdrive.
+ **/
+ed_begin()
+{
+	return ERR_NONE;
+}
+
+/**
+ * Disable everdrive.
+ **/
+ed_end()
+{
+	return ERR_NONE;
+}
+
+/**
+ * Initialize disk.
+ * \return error code
+ **/
+disk_init()
+{
+	if (host_disk_image == 0) {
+		return DISK_ERR_INIT;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Read a single sector.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] dest Destination pointer.
+ * \return
+ *    DISK_ERR_RD1 Read failed
+ *    DISK_ERR_RD2 Open failed
+ **/
+disk_read_single_sector(addr_lo, addr_hi, dest)
+int addr_lo;
+int addr_hi;
+char *dest;
+{
+	if (host_disk_image == 0) {
+		return DISK_ERR_RD2;
+	}
+	host_disk_read_cmds++;
+	host_disk_read_sectors++;
+	if (pread(host_disk_image, dest, 512, host_disk_offset(addr_lo, addr_hi)) != 512) {
+		return DISK_ERR_RD1;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Read consecutive sectors with a single multiple block read command.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] count Number of sectors to read (1-255).
+ * \param [in] dest Destination pointer (must hold count * 512 bytes).
+ * \return
+ *    DISK_ERR_RD1 Read failed
+ *    DISK_ERR_RD2 Open failed
+ **/
+disk_read_sectors(addr_lo, addr_hi, count, dest)
+int addr_lo;
+int addr_hi;
+int count;
+char *dest;
+{
+	if (host_disk_image == 0) {
+		return DISK_ERR_RD2;
+	}
+	host_disk_read_cmds++;
+	host_disk_read_sectors += count;
+	if (pread(host_disk_image, dest, 512 * count, host_disk_offset(addr_lo, addr_hi)) != (512 * count)) {
+		return DISK_ERR_RD1;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Write a single sector.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] source Data source pointer.
+ * \return
+ *    DISK_ERR_WR1 Write failed
+ **/
+disk_write_single_sector(addr_lo, addr_hi, src)
+int addr_lo;
+int addr_hi;
+char *src;
+{
+	if (host_disk_image == 0) {
+		return DISK_ERR_WR1;
+	}
+	host_disk_write_cmds++;
+	host_disk_write_sectors++;
+	if (pwrite(host_disk_image, src, 512, host_disk_offset(addr_lo, addr_hi)) != 512) {
+		return DISK_ERR_WR1;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Write consecutive sectors with a single multiple block write command.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] count Number of sectors to write (1-255).
+ * \param [in] src Data source pointer (count * 512 bytes).
+ * \return
+ *    DISK_ERR_WR1 Write failed
+ **/
+disk_write_sectors(addr_lo, addr_hi, count, src)
+int addr_lo;
+int addr_hi;
+int count;
+char *src;
+{
+	if (host_disk_image == 0) {
+		return DISK_ERR_WR1;
+	}
+	host_disk_write_cmds++;
+	host_disk_write_sectors += count;
+	if (pwrite(host_disk_image, src, 512 * count, host_disk_offset(addr_lo, addr_hi)) != (512 * count)) {
+		return DISK_ERR_WR1;
+	}
+	return ERR_NONE;
+}
+
+/**
+ * Retrieve card type
+ * \return SD card type (always SD_V2, with bit 0 (SD_HC) clear - sector addressed)
+ **/
+disk_get_cardtype()
+{
+	return SD_V2;
+}
@@ -736,20 +736,34 @@ disk_read_single_sector:
 ;;---------------------------------------------------------------------
 ; name : spi_write_to_card
 ; desc : Write 512 bytes from ram to sd 
-; in   : <ed_block_cp_src [todo]
-; out  : A    Token
+;        Each byte is written straight to the SPI register and the busy
+;        flag polled until it has been sent, as spi_send does, but
+;        without the call, timeout setup and read back of spi_send for
+;        every byte. (Unlike reads there is no auto mode to pace a block
+;        transfer instruction, so one can't be used here.)
+; in   : A    Token
+;        <ed_block_cp_src source (moved on by 512 bytes)
+; out  : C flag is set if the SPI register stayed busy (timeout)
 ;;---------------------------------------------------------------------
 spi_write_to_card:  
-    ; We don't use memory copy here.
-
     ; Send token
     jsr    spi_send
-    
+
     ; Copy first 256 bytes
     cly
 .l0:
     lda    [ed_block_cp_src], Y
-    jsr    spi_send
+    sta    SPI_REG_ADDR + REG_SPI
+    clx
+.w0:
+    lda    SPI_REG_ADDR + REG_STATE
+    lsr    a                        ; STATE_SPI (bit 0) into the carry
+    bcs    .n0
+    dex
+    bne    .w0
+    sec                             ; timeout
+    rts
+.n0:
     iny
     bne    .l0
 
@@ -759,12 +773,23 @@ spi_write_to_card:
     cly
 .l1:
     lda    [ed_block_cp_src], Y
-    jsr    spi_send
+    sta    SPI_REG_ADDR + REG_SPI
+    clx
+.w1:
+    lda    SPI_REG_ADDR + REG_STATE
+    lsr    a
+    bcs    .n1
+    dex
+    bne    .w1
+    sec
+    rts
+.n1:
     iny
     bne    .l1
     
     inc    <ed_block_cp_src+1
     
+    clc
     rts
     
 ;;---------------------------------------------------------------------
@@ -833,6 +858,11 @@ disk_write_single_sector:
     
     lda    #SD_DATA_START_BLOCK
     jsr    spi_write_to_card
+    bcc    .l2
+        SPI_SS_OFF
+        ldx    #DISK_ERR_WR1
+        rts
+.l2:
     jsr    spi_finalize_write
     
     SPI_SS_OFF
@@ -906,7 +936,10 @@ disk_write_sector:
     phy
     lda    #SD_WRITE_MULTIPLE_TOKEN
     jsr    spi_write_to_card
+    ldx    #DISK_ERR_WR1
+    bcs    .l4
     jsr    spi_finalize_write
+.l4:
     ply
     
     cpx    #ERR_NONE
@@ -131,6 +131,51 @@ int *dest;
 #endasm
 }
 
+/**
+ * Read consecutive sectors with a single multiple block read command.
+ * For a standard SD card, the address is a standard byte address.
+ * For a SD HC, it's the sector address.
+ * Note that the address is a 32 bits word.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] count Number of sectors to read (1-255).
+ * \param [in] dest Destination pointer (must hold count * 512 bytes).
+ * \return 
+ *    DISK_ERR_RD1 Read failed
+ *    DISK_ERR_RD2 Open failed
+ **/
+disk_read_sectors (addr_lo, addr_hi, count, dest)
+int addr_lo;
+int addr_hi;
+int count;
+int *dest;
+{
+#asm
+    lda    [__stack]
+    sta     <ed_block_cp_dst  
+    ldy    #1
+    lda    [__stack], Y
+    sta    <ed_block_cp_dst+1
+    iny
+    lda    [__stack], Y
+    sta    <_ed_count
+    iny
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+2
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+3
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+1
+    sd_call  disk_read_sector
+#endasm
+}
+
 /**
  * Write a single sector.
  * For a standard SD card, the address is a standard byte address.
@@ -169,6 +214,53 @@ int *src;
 #endasm
 }
 
+/**
+ * Write consecutive sectors with a single multiple block write command.
+ * The number of blocks is first sent with ACMD23 (SET_WR_BLK_ERASE_COUNT)
+ * so that the card can pre-erase them.
+ * For a standard SD card, the address is a standard byte address.
+ * For a SD HC, it's the sector address.
+ * Note that the address is a 32 bits word.
+ * \param [in] addr_lo Least significant word.
+ * \param [in] addr_hi Most significant word.
+ * \param [in] count Number of sectors to write (1-255).
+ * \param [in] src Data source pointer (count * 512 bytes).
+ * \return 
+ *    DISK_ERR_WR1 Write failed
+ *    DISK_ERR_WR3 Sector pre-erase failed
+ **/
+disk_write_sectors(addr_lo, addr_hi, count, src)
+int addr_lo;
+int addr_hi;
+int count;
+int *src;
+{
+#asm
+    lda    [__stack]
+    sta    <ed_block_cp_src
+    ldy    #1
+    lda    [__stack], Y
+    sta    <ed_block_cp_src+1
+    iny
+    lda    [__stack], Y
+    sta    <_ed_count
+    iny
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+2
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+3
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr
+    iny
+    lda    [__stack], Y
+    sta    <_ed_addr+1
+    sd_call  disk_write_sector
+#endasm
+}
+
 /**
  * Retrieve card type
  * \return SD card type (either SD_V2 or SD_HC)